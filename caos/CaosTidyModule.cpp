@@ -12,7 +12,9 @@
 #include "../clang-tidy/ClangTidyModuleRegistry.h"
 #include "MagicNumbersCheck.h"
 #include "IdentifierNamingCheck.h"
+#include "LanguagePolicy.h"
 #include <iostream>
+#include <memory>
 
 namespace clang {
 namespace tidy {
@@ -21,10 +23,28 @@ namespace caos {
 class CaosModule : public ClangTidyModule {
 public:
   void addCheckFactories(ClangTidyCheckFactories &CheckFactories) override {
-    CheckFactories.registerCheck<MagicNumbersCheck>(
-        "caos-magic-numbers");
-    CheckFactories.registerCheck<IdentifierNamingCheck>(
-        "caos-identifier-naming");
+    // Checks are created once the language of the translation unit is known,
+    // so C gets the instantiations without the C++ and Objective-C paths.
+    CheckFactories.registerCheckFactory(
+        "caos-magic-numbers",
+        [](StringRef Name,
+           ClangTidyContext *Context) -> std::unique_ptr<ClangTidyCheck> {
+          if (isPlainC(Context->getLangOpts()))
+            return std::make_unique<MagicNumbersCheckFor<CLanguagePolicy>>(
+                Name, Context);
+          return std::make_unique<MagicNumbersCheckFor<AnyLanguagePolicy>>(
+              Name, Context);
+        });
+    CheckFactories.registerCheckFactory(
+        "caos-identifier-naming",
+        [](StringRef Name,
+           ClangTidyContext *Context) -> std::unique_ptr<ClangTidyCheck> {
+          if (isPlainC(Context->getLangOpts()))
+            return std::make_unique<IdentifierNamingCheckFor<CLanguagePolicy>>(
+                Name, Context);
+          return std::make_unique<IdentifierNamingCheckFor<AnyLanguagePolicy>>(
+              Name, Context);
+        });
   }
 };
 
@@ -0,0 +1,152 @@
+//===--- CheckPerfCounters.cpp - clang-tidy -------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "CheckPerfCounters.h"
+#include "llvm/Support/Process.h"
+#include <optional>
+#include <string>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+static bool getDefaultEnabled() {
+  std::optional<std::string> Env =
+      llvm::sys::Process::GetEnv("CAOS_PERF_COUNTERS");
+  return Env && (*Env == "1" || StringRef(*Env).equals_insensitive("true"));
+}
+
+#ifdef __linux__
+static int openEvent(uint64_t Config, int GroupFD) {
+  perf_event_attr Attr = {};
+  Attr.size = sizeof(Attr);
+  Attr.type = PERF_TYPE_HARDWARE;
+  Attr.config = Config;
+  // User space only: allowed with the default perf_event_paranoid of 2.
+  Attr.exclude_kernel = 1;
+  Attr.exclude_hv = 1;
+  Attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // The calling thread, on any CPU.
+  return static_cast<int>(syscall(SYS_perf_event_open, &Attr, 0, -1, GroupFD,
+                                  PERF_FLAG_FD_CLOEXEC));
+}
+#endif
+
+CheckPerfCounters::CheckPerfCounters(
+    const ClangTidyCheck::OptionsView &Options)
+    : Enabled(Options.getLocalOrGlobal("PerfCounters", getDefaultEnabled())) {
+#ifdef __linux__
+  if (!Enabled)
+    return;
+  // The events are counted from here on; scopes diff two reads of the group,
+  // which is one system call each.
+  static const uint64_t Configs[E_Count] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+  for (int E = 0; E < E_Count; ++E) {
+    EventFDs[E] = openEvent(Configs[E], GroupFD);
+    if (EventFDs[E] < 0) {
+      // All or nothing, so that the events are always comparable.
+      for (int Opened = 0; Opened < E; ++Opened)
+        close(EventFDs[Opened]);
+      for (int &FD : EventFDs)
+        FD = -1;
+      GroupFD = -1;
+      return;
+    }
+    if (E == 0)
+      GroupFD = EventFDs[E];
+  }
+#endif
+}
+
+CheckPerfCounters::~CheckPerfCounters() {
+#ifdef __linux__
+  for (int FD : EventFDs)
+    if (FD >= 0)
+      close(FD);
+#endif
+}
+
+bool CheckPerfCounters::read(Reading &Result) const {
+#ifdef __linux__
+  if (GroupFD < 0)
+    return false;
+  // PERF_FORMAT_GROUP layout: nr, time_enabled, time_running, values[nr].
+  uint64_t Buffer[3 + E_Count];
+  if (::read(GroupFD, Buffer, sizeof(Buffer)) != sizeof(Buffer) ||
+      Buffer[0] != E_Count)
+    return false;
+  Result.TimeEnabled = Buffer[1];
+  Result.TimeRunning = Buffer[2];
+  for (int E = 0; E < E_Count; ++E)
+    Result.Values[E] = Buffer[3 + E];
+  return true;
+#else
+  return false;
+#endif
+}
+
+void CheckPerfCounters::begin() const {
+  StartTime = std::chrono::steady_clock::now();
+  HaveStart = read(Start);
+}
+
+void CheckPerfCounters::end() const {
+  Reading Stop;
+  const bool HaveReading = HaveStart && read(Stop);
+  ++Calls;
+  WallNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - StartTime)
+                .count();
+  if (!HaveReading)
+    return;
+
+  const uint64_t EnabledNs = Stop.TimeEnabled - Start.TimeEnabled;
+  const uint64_t RunningNs = Stop.TimeRunning - Start.TimeRunning;
+  if (RunningNs == 0)
+    return;
+  // Scale up if the kernel multiplexed the group with other events.
+  for (int E = 0; E < E_Count; ++E) {
+    uint64_t Delta = Stop.Values[E] - Start.Values[E];
+    if (RunningNs < EnabledNs)
+      Delta = static_cast<uint64_t>(static_cast<double>(Delta) * EnabledNs /
+                                    RunningNs);
+    Totals[E] += Delta;
+  }
+}
+
+void CheckPerfCounters::addCounters(StatisticsCounters &Values) const {
+  Values.emplace_back("perf.calls", Calls);
+  Values.emplace_back("perf.wall_ns", WallNs);
+  if (GroupFD >= 0) {
+    Values.emplace_back("perf.cycles", Totals[E_Cycles]);
+    Values.emplace_back("perf.instructions", Totals[E_Instructions]);
+    Values.emplace_back("perf.cache_misses", Totals[E_CacheMisses]);
+    Values.emplace_back("perf.branch_misses", Totals[E_BranchMisses]);
+  }
+  Calls = 0;
+  WallNs = 0;
+  for (uint64_t &Total : Totals)
+    Total = 0;
+}
+
+void CheckPerfCounters::store(const ClangTidyCheck::OptionsView &Options,
+                              ClangTidyOptions::OptionMap &Opts) const {
+  Options.store(Opts, "PerfCounters", Enabled);
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
@@ -0,0 +1,100 @@
+//===--- CheckPerfCounters.h - clang-tidy -----------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_CHECKPERFCOUNTERS_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_CHECKPERFCOUNTERS_H
+
+#include "../clang-tidy/ClangTidyCheck.h"
+#include "CheckStatistics.h"
+#include <chrono>
+#include <cstdint>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+/// Hardware performance counters (cycles, instructions, cache misses, branch
+/// misses) of the hot entry points of a check, summed over a translation unit.
+///
+/// Enabled by the \c PerfCounters option, which defaults to the
+/// \c CAOS_PERF_COUNTERS environment variable; the sums are written to the
+/// statistics stream (see \c StatisticsOptions) as "perf.*" counters. The
+/// counters are read with \c perf_event_open on Linux. Where it is unavailable
+/// (other systems, containers with a strict perf_event_paranoid or seccomp
+/// profile) only the number of calls and the wall-clock time are reported.
+class CheckPerfCounters {
+public:
+  explicit CheckPerfCounters(const ClangTidyCheck::OptionsView &Options);
+  ~CheckPerfCounters();
+
+  CheckPerfCounters(const CheckPerfCounters &) = delete;
+  CheckPerfCounters &operator=(const CheckPerfCounters &) = delete;
+
+  bool isEnabled() const { return Enabled; }
+
+  /// Counts the events of its lifetime. Scopes of one object must not nest.
+  class Scope {
+  public:
+    explicit Scope(const CheckPerfCounters &Counters)
+        : Counters(Counters.Enabled ? &Counters : nullptr) {
+      if (this->Counters)
+        this->Counters->begin();
+    }
+    ~Scope() {
+      if (Counters)
+        Counters->end();
+    }
+
+  private:
+    const CheckPerfCounters *Counters;
+  };
+
+  /// Appends the sums to \p Values and resets them.
+  void addCounters(StatisticsCounters &Values) const;
+
+  void store(const ClangTidyCheck::OptionsView &Options,
+             ClangTidyOptions::OptionMap &Opts) const;
+
+private:
+  enum Event {
+    E_Cycles,
+    E_Instructions,
+    E_CacheMisses,
+    E_BranchMisses,
+    E_Count,
+  };
+
+  /// Raw values of the event group.
+  struct Reading {
+    uint64_t TimeEnabled = 0;
+    uint64_t TimeRunning = 0;
+    uint64_t Values[E_Count] = {};
+  };
+
+  bool read(Reading &Result) const;
+  void begin() const;
+  void end() const;
+
+  const bool Enabled;
+  /// Group leader of the events, or -1 if hardware counters are unavailable.
+  int GroupFD = -1;
+  int EventFDs[E_Count] = {-1, -1, -1, -1};
+
+  mutable Reading Start;
+  mutable bool HaveStart = false;
+  mutable std::chrono::steady_clock::time_point StartTime;
+  mutable uint64_t Calls = 0;
+  mutable uint64_t WallNs = 0;
+  mutable uint64_t Totals[E_Count] = {};
+};
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_CHECKPERFCOUNTERS_H
@@ -0,0 +1,293 @@
+//===--- CheckStatistics.cpp - clang-tidy ---------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "CheckStatistics.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <optional>
+#ifdef LLVM_ON_UNIX
+#include <sys/resource.h>
+#endif
+
+namespace clang {
+namespace tidy {
+
+llvm::ArrayRef<std::pair<caos::StatisticsOptions::ReportMode, StringRef>>
+OptionEnumMapping<caos::StatisticsOptions::ReportMode>::getEnumMapping() {
+  static constexpr std::pair<caos::StatisticsOptions::ReportMode, StringRef>
+      Mapping[] = {{caos::StatisticsOptions::RM_PerFile, "PerFile"},
+                   {caos::StatisticsOptions::RM_Aggregate, "Aggregate"}};
+  return llvm::ArrayRef(Mapping);
+}
+
+namespace caos {
+
+namespace {
+
+/// Statistics output file, shared by all checks and translation units of the
+/// process.
+class StatisticsWriter {
+public:
+  explicit StatisticsWriter(StringRef File) : File(File) {}
+
+  ~StatisticsWriter() {
+    if (!Totals.empty())
+      writeTotals();
+  }
+
+  void writeTranslationUnit(StringRef CheckName, StringRef MainFile,
+                            const StatisticsCounters &Counters) {
+    std::string Line;
+    llvm::raw_string_ostream OS(Line);
+    llvm::json::OStream J(OS);
+    J.object([&] {
+      J.attribute("file", MainFile);
+      J.attribute("check", CheckName);
+      J.attributeObject("counters", [&] {
+        for (const auto &[Name, Value] : Counters)
+          J.attribute(Name, Value);
+      });
+    });
+    OS << '\n';
+    write(OS.str());
+  }
+
+  void accumulate(StringRef CheckName, const StatisticsCounters &Counters) {
+    CheckTotals &Check = Totals[CheckName];
+    ++Check.TranslationUnits;
+    for (const auto &[Name, Value] : Counters)
+      addCounter(Check.Counters[Name], Name, Value);
+  }
+
+  bool hasTotals() const { return !Totals.empty(); }
+
+  /// Writes the totals as a JSON object and forgets them.
+  void takeTotals(llvm::json::OStream &J) {
+    writeTotalsObject(J);
+    Totals.clear();
+  }
+
+  /// Adds totals written by \c takeTotals.
+  void mergeTotals(const llvm::json::Object &Checks) {
+    for (const auto &[CheckName, Value] : Checks) {
+      const llvm::json::Object *Object = Value.getAsObject();
+      if (!Object)
+        continue;
+      CheckTotals &Check = Totals[CheckName];
+      if (const llvm::json::Value *TranslationUnits =
+              Object->get("translation_units"))
+        if (auto N = TranslationUnits->getAsUINT64())
+          Check.TranslationUnits += *N;
+      if (const llvm::json::Object *Counters = Object->getObject("counters"))
+        for (const auto &[Name, Counter] : *Counters)
+          if (auto N = Counter.getAsUINT64())
+            addCounter(Check.Counters[Name], Name, *N);
+    }
+  }
+
+private:
+  struct CheckTotals {
+    uint64_t TranslationUnits = 0;
+    llvm::StringMap<uint64_t> Counters;
+  };
+
+  static void addCounter(uint64_t &Total, StringRef Name, uint64_t Value) {
+    if (Name.contains("peak_"))
+      Total = std::max(Total, Value);
+    else
+      Total += Value;
+  }
+
+  template <typename MapT> static std::vector<StringRef> sortedKeys(MapT &Map) {
+    std::vector<StringRef> Keys;
+    for (const auto &Entry : Map)
+      Keys.push_back(Entry.getKey());
+    llvm::sort(Keys);
+    return Keys;
+  }
+
+  void writeTotalsObject(llvm::json::OStream &J) {
+    J.object([&] {
+      for (StringRef CheckName : sortedKeys(Totals)) {
+        const CheckTotals &Check = Totals[CheckName];
+        J.attributeObject(CheckName, [&] {
+          J.attribute("translation_units", Check.TranslationUnits);
+          J.attributeObject("counters", [&] {
+            for (StringRef Name : sortedKeys(Check.Counters))
+              J.attribute(Name, Check.Counters.lookup(Name));
+          });
+        });
+      }
+    });
+  }
+
+  void writeTotals() {
+    std::string Line;
+    llvm::raw_string_ostream OS(Line);
+    llvm::json::OStream J(OS);
+    writeTotalsObject(J);
+    OS << '\n';
+    write(OS.str());
+  }
+
+  // Appends whole lines, so that the processes of a parallel run can share
+  // the file.
+  void write(StringRef Line) {
+    if (File == "-") {
+      llvm::errs() << Line;
+      return;
+    }
+    std::error_code EC;
+    llvm::raw_fd_ostream OS(File, EC, llvm::sys::fs::OF_Append);
+    if (EC) {
+      llvm::errs() << "caos: cannot write statistics to " << File << ": "
+                   << EC.message() << "\n";
+      return;
+    }
+    OS << Line;
+  }
+
+  const std::string File;
+  llvm::StringMap<CheckTotals> Totals;
+};
+
+} // namespace
+
+static std::mutex WritersMutex;
+
+// Writers are destroyed, writing the run totals, at exit.
+static llvm::StringMap<std::unique_ptr<StatisticsWriter>> &getWriters() {
+  static llvm::StringMap<std::unique_ptr<StatisticsWriter>> Writers;
+  return Writers;
+}
+
+StatisticsOptions::StatisticsOptions(
+    const ClangTidyCheck::OptionsView &Options) {
+  std::optional<std::string> EnvFile =
+      llvm::sys::Process::GetEnv("CAOS_STATS_FILE");
+  File = Options.getLocalOrGlobal("StatisticsFile", EnvFile.value_or(""));
+
+  Mode = RM_PerFile;
+  if (std::optional<std::string> EnvMode =
+          llvm::sys::Process::GetEnv("CAOS_STATS_MODE"))
+    Mode = StringRef(*EnvMode).equals_insensitive("Aggregate") ? RM_Aggregate
+                                                                : RM_PerFile;
+  Mode = Options.getLocalOrGlobal("StatisticsMode", Mode);
+
+  Memory = false;
+  if (std::optional<std::string> EnvMemory =
+          llvm::sys::Process::GetEnv("CAOS_STATS_MEMORY"))
+    Memory = *EnvMemory == "1" ||
+             StringRef(*EnvMemory).equals_insensitive("true");
+  Memory = Options.getLocalOrGlobal("StatisticsMemory", Memory);
+}
+
+void StatisticsOptions::store(const ClangTidyCheck::OptionsView &Options,
+                              ClangTidyOptions::OptionMap &Opts) const {
+  Options.store(Opts, "StatisticsFile", File);
+  Options.store(Opts, "StatisticsMode", Mode);
+  Options.store(Opts, "StatisticsMemory", Memory);
+}
+
+void StatisticsOptions::report(StringRef CheckName, StringRef MainFile,
+                               const StatisticsCounters &Counters) const {
+  if (!isEnabled())
+    return;
+  std::lock_guard<std::mutex> Lock(WritersMutex);
+  std::unique_ptr<StatisticsWriter> &Writer = getWriters()[File];
+  if (!Writer)
+    Writer = std::make_unique<StatisticsWriter>(File);
+  if (Mode == RM_Aggregate)
+    Writer->accumulate(CheckName, Counters);
+  else
+    Writer->writeTranslationUnit(CheckName, MainFile, Counters);
+}
+
+// Serialized as {"<statistics file>": <totals as written at exit>, ...}.
+std::string takeStatisticsTotals() {
+  std::lock_guard<std::mutex> Lock(WritersMutex);
+  auto &Writers = getWriters();
+  if (llvm::none_of(Writers, [](const auto &Entry) {
+        return Entry.second->hasTotals();
+      }))
+    return "";
+  std::string Serialized;
+  llvm::raw_string_ostream OS(Serialized);
+  llvm::json::OStream J(OS);
+  J.object([&] {
+    for (auto &Entry : Writers) {
+      if (!Entry.second->hasTotals())
+        continue;
+      J.attributeBegin(Entry.getKey());
+      Entry.second->takeTotals(J);
+      J.attributeEnd();
+    }
+  });
+  return OS.str();
+}
+
+void mergeStatisticsTotals(StringRef Serialized) {
+  if (Serialized.empty())
+    return;
+  llvm::Expected<llvm::json::Value> Totals = llvm::json::parse(Serialized);
+  if (!Totals) {
+    llvm::errs() << "caos: cannot read statistics totals: "
+                 << llvm::toString(Totals.takeError()) << "\n";
+    return;
+  }
+  const llvm::json::Object *Files = Totals->getAsObject();
+  if (!Files)
+    return;
+  std::lock_guard<std::mutex> Lock(WritersMutex);
+  for (const auto &[File, Checks] : *Files) {
+    const llvm::json::Object *ChecksObject = Checks.getAsObject();
+    if (!ChecksObject)
+      continue;
+    std::unique_ptr<StatisticsWriter> &Writer = getWriters()[File.str()];
+    if (!Writer)
+      Writer = std::make_unique<StatisticsWriter>(File.str());
+    Writer->mergeTotals(*ChecksObject);
+  }
+}
+
+uint64_t getPeakResidentBytes() {
+#ifdef LLVM_ON_UNIX
+  struct rusage Usage;
+  if (getrusage(RUSAGE_SELF, &Usage) == 0) {
+#ifdef __APPLE__
+    return Usage.ru_maxrss;
+#else
+    // Linux and the BSDs report KiB.
+    return static_cast<uint64_t>(Usage.ru_maxrss) * 1024;
+#endif
+  }
+#endif
+  return 0;
+}
+
+void addPeakResidentCounters(StatisticsCounters &Counters,
+                             uint64_t InitialPeakBytes) {
+  uint64_t PeakBytes = getPeakResidentBytes();
+  Counters.emplace_back("memory.peak_rss_bytes", PeakBytes);
+  Counters.emplace_back("memory.rss_growth_bytes",
+                        PeakBytes > InitialPeakBytes
+                            ? PeakBytes - InitialPeakBytes
+                            : 0);
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
@@ -0,0 +1,106 @@
+//===--- CheckStatistics.h - clang-tidy -------------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_CHECKSTATISTICS_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_CHECKSTATISTICS_H
+
+#include "../clang-tidy/ClangTidyCheck.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+/// Counter names and values of a check for one translation unit.
+///
+/// The aggregate report sums the counters over the run, except for the ones
+/// whose name contains "peak_", for which it keeps the maximum.
+using StatisticsCounters = std::vector<std::pair<std::string, uint64_t>>;
+
+/// Where the hot-path counters of the checks are written to.
+///
+/// Set by the \c StatisticsFile, \c StatisticsMode and \c StatisticsMemory
+/// options, which default to the \c CAOS_STATS_FILE, \c CAOS_STATS_MODE and
+/// \c CAOS_STATS_MEMORY environment variables so that a whole run can be
+/// profiled without touching its configuration.
+class StatisticsOptions {
+public:
+  enum ReportMode {
+    /// One JSON object per check and translation unit, written when the
+    /// translation unit is done.
+    RM_PerFile,
+    /// One JSON object with the sums over the run, written at exit.
+    RM_Aggregate,
+  };
+
+  explicit StatisticsOptions(const ClangTidyCheck::OptionsView &Options);
+
+  void store(const ClangTidyCheck::OptionsView &Options,
+             ClangTidyOptions::OptionMap &Opts) const;
+
+  bool isEnabled() const { return !File.empty(); }
+
+  /// Whether the checks also report the bytes held by their data structures
+  /// and the peak RSS of the process. Walking the structures is not free, so
+  /// this is off unless asked for.
+  bool accountsMemory() const { return isEnabled() && Memory; }
+
+  /// Records the \p Counters of \p CheckName for the translation unit of
+  /// \p MainFile. Thread-safe.
+  void report(StringRef CheckName, StringRef MainFile,
+              const StatisticsCounters &Counters) const;
+
+private:
+  /// Path of the output file; "-" is stderr, empty disables statistics.
+  std::string File;
+  ReportMode Mode;
+  bool Memory;
+};
+
+/// Takes the aggregate totals this process has accumulated so far, which it
+/// then no longer writes at exit, serialized for \c mergeStatisticsTotals.
+/// Empty if there are none.
+///
+/// Lets the worker processes of caos-batch hand their totals over to the
+/// coordinator, so that a run writes one totals line per statistics file
+/// rather than one per worker.
+std::string takeStatisticsTotals();
+
+/// Adds totals returned by \c takeStatisticsTotals, possibly in another
+/// process, to those this process writes at exit.
+void mergeStatisticsTotals(StringRef Serialized);
+
+/// Returns the peak resident set size of the process in bytes, or 0 where it
+/// is not known.
+uint64_t getPeakResidentBytes();
+
+/// Returns the heap bytes held by \p S; short strings are stored inline.
+inline uint64_t getHeapBytes(const std::string &S) {
+  return S.capacity() >= sizeof(S) ? S.capacity() + 1 : 0;
+}
+
+/// Adds the peak RSS of the process and its growth since \p InitialPeakBytes
+/// (as returned by \c getPeakResidentBytes) to \p Counters.
+void addPeakResidentCounters(StatisticsCounters &Counters,
+                             uint64_t InitialPeakBytes);
+
+} // namespace caos
+
+template <> struct OptionEnumMapping<caos::StatisticsOptions::ReportMode> {
+  static llvm::ArrayRef<
+      std::pair<caos::StatisticsOptions::ReportMode, StringRef>>
+  getEnumMapping();
+};
+
+} // namespace tidy
+} // namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_CHECKSTATISTICS_H
@@ -0,0 +1,70 @@
+//===--- HeaderVerdictStore.cpp - clang-tidy ------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "HeaderVerdictStore.h"
+#include "clang/Basic/LangOptions.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/xxhash.h"
+#include <string>
+#include <vector>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+uint64_t hashHeaderContents(StringRef Contents) {
+  return llvm::xxHash64(Contents);
+}
+
+uint64_t getOptionsFingerprint(ClangTidyCheck &Check) {
+  ClangTidyOptions::OptionMap Options;
+  Check.storeOptions(Options);
+
+  // StringMap iteration order is unspecified, so serialize in key order.
+  std::vector<StringRef> Keys;
+  Keys.reserve(Options.size());
+  for (const auto &Option : Options)
+    Keys.push_back(Option.getKey());
+  llvm::sort(Keys);
+
+  std::string Serialized;
+  for (StringRef Key : Keys) {
+    Serialized += Key;
+    Serialized += '=';
+    Serialized += Options.lookup(Key).Value;
+    Serialized += '\n';
+  }
+  return llvm::xxHash64(Serialized);
+}
+
+uint64_t getTranslationUnitFingerprint(const LangOptions &LangOpts,
+                                       const SourceManager &SM) {
+  // The preprocessor writes the predefined macros to a "<built-in>" buffer,
+  // created right after the main file. Only memory buffers are looked at, so
+  // that no file is read.
+  StringRef Predefines;
+  for (unsigned I = 1, E = SM.local_sloc_entry_size(); I < E; ++I) {
+    const SrcMgr::SLocEntry &Entry = SM.getLocalSLocEntry(I);
+    if (!Entry.isFile() || Entry.getFile().getContentCache().OrigEntry)
+      continue;
+    const SourceLocation Loc =
+        SourceLocation::getFromRawEncoding(Entry.getOffset());
+    if (SM.getBufferName(Loc) == "<built-in>") {
+      Predefines = SM.getBufferData(SM.getFileID(Loc));
+      break;
+    }
+  }
+  return llvm::hash_combine(bool(LangOpts.CPlusPlus), bool(LangOpts.ObjC),
+                            LangOpts.LangStd, llvm::xxHash64(Predefines));
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
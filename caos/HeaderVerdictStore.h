@@ -0,0 +1,85 @@
+//===--- HeaderVerdictStore.h - clang-tidy ----------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_HEADERVERDICTSTORE_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_HEADERVERDICTSTORE_H
+
+#include "../clang-tidy/ClangTidyCheck.h"
+#include "llvm/ADT/DenseMap.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+/// Identifies the results of a check for a header: a hash of the header
+/// contents and a fingerprint of the options the check ran with, combined
+/// with that of the translation unit (see \c getTranslationUnitFingerprint).
+using HeaderVerdictKey = std::pair<uint64_t, uint64_t>;
+
+/// Process-wide store of per-header check results, shared by all translation
+/// units analysed in one run.
+///
+/// The first translation unit that analyses a header publishes its findings
+/// (\p VerdictT) here; later translation units including the same header with
+/// the same options, in the same language and with the same predefined
+/// macros replay them instead of analysing the header again.
+///
+/// Note that a header is assumed to mean the same thing in every such
+/// translation unit, which may not hold if it depends on macros defined by
+/// the includer before including it. That is why the checks only use this
+/// store when asked to.
+template <typename VerdictT> class HeaderVerdictStore {
+public:
+  static HeaderVerdictStore &instance() {
+    static HeaderVerdictStore Store;
+    return Store;
+  }
+
+  std::shared_ptr<const VerdictT> lookup(const HeaderVerdictKey &Key) const {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    auto It = Verdicts.find(Key);
+    return It == Verdicts.end() ? nullptr : It->second;
+  }
+
+  /// Publishes \p Verdict unless another translation unit already did.
+  void insert(const HeaderVerdictKey &Key, VerdictT Verdict) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Verdicts.try_emplace(Key,
+                         std::make_shared<const VerdictT>(std::move(Verdict)));
+  }
+
+private:
+  HeaderVerdictStore() = default;
+
+  mutable std::mutex Mutex;
+  llvm::DenseMap<HeaderVerdictKey, std::shared_ptr<const VerdictT>> Verdicts;
+};
+
+/// Returns a hash of the header contents for use in a \c HeaderVerdictKey.
+uint64_t hashHeaderContents(StringRef Contents);
+
+/// Returns a fingerprint of the effective options of \p Check, as reported by
+/// its \c storeOptions().
+uint64_t getOptionsFingerprint(ClangTidyCheck &Check);
+
+/// Returns a fingerprint of what, besides its contents, selects how a header
+/// of the translation unit of \p SM is parsed: the language and standard in
+/// \p LangOpts, and the macros predefined for the target, the standard and
+/// the -D, -U and -include flags.
+uint64_t getTranslationUnitFingerprint(const LangOptions &LangOpts,
+                                       const SourceManager &SM);
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_HEADERVERDICTSTORE_H
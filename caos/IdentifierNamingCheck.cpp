@@ -14,11 +14,13 @@
 #include "clang/Lex/Preprocessor.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMapInfo.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/FormatVariadic.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Regex.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/YAMLParser.h"
 
 #define DEBUG_TYPE "clang-tidy"
@@ -388,20 +390,104 @@ std::string IdentifierNamingCheck::HungarianNotation::getDeclTypeName(
 
 IdentifierNamingCheck::IdentifierNamingCheck(StringRef Name,
                                              ClangTidyContext *Context)
-    : RenamerClangTidyCheck(Name, Context), Context(Context), CheckName(Name),
+    : RenamerClangTidyCheck(Name, Context),
+      Trace(Options, Name, Context->getCurrentFile()), Context(Context),
+      CheckName(Name),
       GetConfigPerFile(Options.get("GetConfigPerFile", true)),
-      IgnoreFailedSplit(Options.get("IgnoreFailedSplit", false)) {
+      IgnoreFailedSplit(Options.get("IgnoreFailedSplit", false)),
+      DeduplicateHeaderDiagnostics(
+          Options.get("DeduplicateHeaderDiagnostics", false)),
+      TimeBudgetMs(Options.getLocalOrGlobal("TimeBudgetMs", 0U)),
+      MemoryBudgetMiB(Options.getLocalOrGlobal("MemoryBudgetMiB", 0U)),
+      MaxDiagnosticsPerFile(
+          Options.getLocalOrGlobal("MaxDiagnosticsPerFile", 0U)),
+      Budget(TimeBudgetMs, MemoryBudgetMiB), Statistics(Options),
+      Perf(Options), MainFile(Context->getCurrentFile()), NoLints(Name),
+      LineFilter(Context->getGlobalOptions()) {
+  Counters.NamesChecked.resize(SK_Invalid + 1);
+  if (Statistics.accountsMemory())
+    Memory.InitialPeakResidentBytes = getPeakResidentBytes();
+  Trace.endConstruction();
+}
 
-  auto IterAndInserted = NamingStylesCache.try_emplace(
-      llvm::sys::path::parent_path(Context->getCurrentFile()),
-      getFileStyleFromOptions(Options));
-  assert(IterAndInserted.second && "Couldn't insert Style");
-  // Holding a reference to the data in the vector is safe as it should never
-  // move.
-  MainFileStyle = &IterAndInserted.first->getValue();
+// Buckets and entries of the map; the heap held by the values isn't included.
+template <typename T>
+static uint64_t getStringMapBytes(const llvm::StringMap<T> &Map) {
+  uint64_t Bytes = static_cast<uint64_t>(Map.getNumBuckets()) *
+                   (sizeof(llvm::StringMapEntryBase *) + sizeof(unsigned));
+  for (const auto &Entry : Map)
+    Bytes += sizeof(Entry) + Entry.getKeyLength() + 1;
+  return Bytes;
 }
 
-IdentifierNamingCheck::~IdentifierNamingCheck() = default;
+static uint64_t getHungarianNotationBytes(
+    const IdentifierNamingCheck::HungarianNotationOption &HNOption) {
+  uint64_t Bytes = 0;
+  for (const llvm::StringMap<std::string> *Map :
+       {&HNOption.General, &HNOption.CString, &HNOption.PrimitiveType,
+        &HNOption.UserDefinedType, &HNOption.DerivedType}) {
+    Bytes += getStringMapBytes(*Map);
+    for (const auto &Entry : *Map)
+      Bytes += getHeapBytes(Entry.getValue());
+  }
+  return Bytes;
+}
+
+// The compiled IgnoredRegexp of the styles is opaque and not counted.
+void IdentifierNamingCheck::addMemoryCounters(
+    StatisticsCounters &Values) const {
+  uint64_t StylesBytes = getStringMapBytes(NamingStylesCache);
+  uint64_t HungarianBytes = 0;
+  for (const auto &Entry : NamingStylesCache) {
+    const FileStyle &Style = Entry.getValue();
+    if (!Style.isActive())
+      continue;
+    StylesBytes +=
+        Style.getStyles().size() * sizeof(std::optional<NamingStyle>);
+    for (const std::optional<NamingStyle> &NS : Style.getStyles())
+      if (NS)
+        StylesBytes += getHeapBytes(NS->Prefix) + getHeapBytes(NS->Suffix) +
+                       getHeapBytes(NS->IgnoredRegexpStr);
+    HungarianBytes += getHungarianNotationBytes(Style.getHNOption());
+  }
+  Values.emplace_back("memory.naming_styles_cache_bytes", StylesBytes);
+  Values.emplace_back("memory.hungarian_maps_bytes", HungarianBytes);
+  Values.emplace_back("memory.failure_map_bytes", Memory.FailureBytes);
+  addPeakResidentCounters(Values, Memory.InitialPeakResidentBytes);
+}
+
+IdentifierNamingCheck::~IdentifierNamingCheck() {
+  llvm::TimeTraceScope TimeScope("EndOfTranslationUnit", CheckName);
+  if (Statistics.isEnabled()) {
+    StatisticsCounters Values;
+    for (int SK = 0; SK < SK_Count; ++SK)
+      if (Counters.NamesChecked[SK] != 0)
+        Values.emplace_back(("names_checked." + StyleNames[SK]).str(),
+                            Counters.NamesChecked[SK]);
+    Values.emplace_back("names_checked.None",
+                        Counters.NamesChecked[SK_Invalid]);
+    Values.emplace_back("names_suppressed", Counters.NamesSuppressed);
+    Values.emplace_back("names_filtered", Counters.NamesFiltered);
+    Values.emplace_back("regex_evaluations", Counters.RegexEvaluations);
+    Values.emplace_back("fixups_computed", Counters.FixupsComputed);
+    Values.emplace_back("style_cache_hits", Counters.StyleCacheHits);
+    Values.emplace_back("style_cache_misses", Counters.StyleCacheMisses);
+    if (Statistics.accountsMemory())
+      addMemoryCounters(Values);
+    if (Perf.isEnabled())
+      Perf.addCounters(Values);
+    Statistics.report(CheckName, MainFile, Values);
+  }
+
+  // Publish the results for the headers analysed in this translation unit,
+  // unless the analysis was cut short and they may be incomplete.
+  if (Budget.isExceeded() || hasReachedDiagnosticsCap())
+    return;
+  for (auto &[FID, State] : Headers)
+    if (!State.Replayed)
+      HeaderVerdictStore<HeaderFailures>::instance().insert(
+          State.Key, std::move(State.Recorded));
+}
 
 bool IdentifierNamingCheck::HungarianNotation::checkOptionValid(
     int StyleKindIndex) const {
@@ -802,7 +888,8 @@ void IdentifierNamingCheck::HungarianNotation::loadDefaultConfig(
 void IdentifierNamingCheck::storeOptions(ClangTidyOptions::OptionMap &Opts) {
   RenamerClangTidyCheck::storeOptions(Opts);
   SmallString<64> StyleString;
-  ArrayRef<std::optional<NamingStyle>> Styles = MainFileStyle->getStyles();
+  const FileStyle &MainStyle = getMainFileStyle();
+  ArrayRef<std::optional<NamingStyle>> Styles = MainStyle.getStyles();
   for (size_t I = 0; I < SK_Count; ++I) {
     if (!Styles[I])
       continue;
@@ -828,8 +915,16 @@ void IdentifierNamingCheck::storeOptions(ClangTidyOptions::OptionMap &Opts) {
   }
   Options.store(Opts, "GetConfigPerFile", GetConfigPerFile);
   Options.store(Opts, "IgnoreFailedSplit", IgnoreFailedSplit);
+  Options.store(Opts, "DeduplicateHeaderDiagnostics",
+                DeduplicateHeaderDiagnostics);
+  Options.store(Opts, "TimeBudgetMs", TimeBudgetMs);
+  Options.store(Opts, "MemoryBudgetMiB", MemoryBudgetMiB);
+  Options.store(Opts, "MaxDiagnosticsPerFile", MaxDiagnosticsPerFile);
+  Statistics.store(Options, Opts);
+  Perf.store(Options, Opts);
+  Trace.store(Options, Opts);
   Options.store(Opts, "IgnoreMainLikeFunctions",
-                MainFileStyle->isIgnoringMainLikeFunction());
+                MainStyle.isIgnoringMainLikeFunction());
 }
 
 bool IdentifierNamingCheck::matchesStyle(
@@ -862,7 +957,10 @@ bool IdentifierNamingCheck::matchesStyle(
   if (Name.starts_with("_") || Name.ends_with("_"))
     return false;
 
-  if (Style.Case && !Matchers[static_cast<size_t>(*Style.Case)].match(Name))
+  if (!Style.Case)
+    return true;
+  ++Counters.RegexEvaluations;
+  if (!Matchers[static_cast<size_t>(*Style.Case)].match(Name))
     return false;
 
   return true;
@@ -1066,38 +1164,47 @@ std::string IdentifierNamingCheck::fixupWithStyle(
   return (Style.Prefix + HungarianPrefix + Mid + Style.Suffix).str();
 }
 
-StyleKind IdentifierNamingCheck::findStyleKind(
+template <typename LanguagePolicy>
+StyleKind IdentifierNamingCheck::findStyleKindFor(
     const NamedDecl *D,
     ArrayRef<std::optional<IdentifierNamingCheck::NamingStyle>> NamingStyles,
     bool IgnoreMainLikeFunctions) const {
   assert(D && D->getIdentifier() && !D->getName().empty() && !D->isImplicit() &&
          "Decl must be an explicit identifier with a name.");
+  // The C++ and Objective-C declaration kinds are left out of the C
+  // instantiation, along with the properties only they give to the others.
+  constexpr bool MayBeCPlusPlus = LanguagePolicy::MayBeCPlusPlus;
 
-  if (isa<ObjCIvarDecl>(D) && NamingStyles[SK_ObjcIvar])
-    return SK_ObjcIvar;
+  if constexpr (LanguagePolicy::MayBeObjC) {
+    if (isa<ObjCIvarDecl>(D) && NamingStyles[SK_ObjcIvar])
+      return SK_ObjcIvar;
+  }
 
   if (isa<TypedefDecl>(D) && NamingStyles[SK_Typedef])
     return SK_Typedef;
 
-  if (isa<TypeAliasDecl>(D) && NamingStyles[SK_TypeAlias])
-    return SK_TypeAlias;
+  if constexpr (MayBeCPlusPlus) {
+    if (isa<TypeAliasDecl>(D) && NamingStyles[SK_TypeAlias])
+      return SK_TypeAlias;
 
-  if (const auto *Decl = dyn_cast<NamespaceDecl>(D)) {
-    if (Decl->isAnonymousNamespace())
-      return SK_Invalid;
+    if (const auto *Decl = dyn_cast<NamespaceDecl>(D)) {
+      if (Decl->isAnonymousNamespace())
+        return SK_Invalid;
 
-    if (Decl->isInline() && NamingStyles[SK_InlineNamespace])
-      return SK_InlineNamespace;
+      if (Decl->isInline() && NamingStyles[SK_InlineNamespace])
+        return SK_InlineNamespace;
 
-    if (NamingStyles[SK_Namespace])
-      return SK_Namespace;
+      if (NamingStyles[SK_Namespace])
+        return SK_Namespace;
+    }
   }
 
   if (isa<EnumDecl>(D) && NamingStyles[SK_Enum])
     return SK_Enum;
 
   if (const auto *EnumConst = dyn_cast<EnumConstantDecl>(D)) {
-    if (cast<EnumDecl>(EnumConst->getDeclContext())->isScoped() &&
+    if (MayBeCPlusPlus &&
+        cast<EnumDecl>(EnumConst->getDeclContext())->isScoped() &&
         NamingStyles[SK_ScopedEnumConstant])
       return SK_ScopedEnumConstant;
 
@@ -1110,36 +1217,38 @@ StyleKind IdentifierNamingCheck::findStyleKind(
     return SK_Invalid;
   }
 
-  if (const auto *Decl = dyn_cast<CXXRecordDecl>(D)) {
-    if (Decl->isAnonymousStructOrUnion())
-      return SK_Invalid;
+  if constexpr (MayBeCPlusPlus) {
+    if (const auto *Decl = dyn_cast<CXXRecordDecl>(D)) {
+      if (Decl->isAnonymousStructOrUnion())
+        return SK_Invalid;
 
-    if (!Decl->getCanonicalDecl()->isThisDeclarationADefinition())
-      return SK_Invalid;
+      if (!Decl->getCanonicalDecl()->isThisDeclarationADefinition())
+        return SK_Invalid;
 
-    if (Decl->hasDefinition() && Decl->isAbstract() &&
-        NamingStyles[SK_AbstractClass])
-      return SK_AbstractClass;
+      if (Decl->hasDefinition() && Decl->isAbstract() &&
+          NamingStyles[SK_AbstractClass])
+        return SK_AbstractClass;
 
-    if (Decl->isStruct() && NamingStyles[SK_Struct])
-      return SK_Struct;
+      if (Decl->isStruct() && NamingStyles[SK_Struct])
+        return SK_Struct;
 
-    if (Decl->isStruct() && NamingStyles[SK_Class])
-      return SK_Class;
+      if (Decl->isStruct() && NamingStyles[SK_Class])
+        return SK_Class;
 
-    if (Decl->isClass() && NamingStyles[SK_Class])
-      return SK_Class;
+      if (Decl->isClass() && NamingStyles[SK_Class])
+        return SK_Class;
 
-    if (Decl->isClass() && NamingStyles[SK_Struct])
-      return SK_Struct;
+      if (Decl->isClass() && NamingStyles[SK_Struct])
+        return SK_Struct;
 
-    if (Decl->isUnion() && NamingStyles[SK_Union])
-      return SK_Union;
+      if (Decl->isUnion() && NamingStyles[SK_Union])
+        return SK_Union;
 
-    if (Decl->isEnum() && NamingStyles[SK_Enum])
-      return SK_Enum;
+      if (Decl->isEnum() && NamingStyles[SK_Enum])
+        return SK_Enum;
 
-    return SK_Invalid;
+      return SK_Invalid;
+    }
   }
 
   // C records (CXXRecordDecl is a subclass of RecordDecl, so this check must be placed after CXXRecordDecl)
@@ -1173,14 +1282,17 @@ StyleKind IdentifierNamingCheck::findStyleKind(
         return SK_Constant;
     }
 
-    if (Decl->getAccess() == AS_private && NamingStyles[SK_PrivateMember])
-      return SK_PrivateMember;
+    if constexpr (MayBeCPlusPlus) {
+      if (Decl->getAccess() == AS_private && NamingStyles[SK_PrivateMember])
+        return SK_PrivateMember;
 
-    if (Decl->getAccess() == AS_protected && NamingStyles[SK_ProtectedMember])
-      return SK_ProtectedMember;
+      if (Decl->getAccess() == AS_protected &&
+          NamingStyles[SK_ProtectedMember])
+        return SK_ProtectedMember;
 
-    if (Decl->getAccess() == AS_public && NamingStyles[SK_PublicMember])
-      return SK_PublicMember;
+      if (Decl->getAccess() == AS_public && NamingStyles[SK_PublicMember])
+        return SK_PublicMember;
+    }
 
     if (NamingStyles[SK_Member])
       return SK_Member;
@@ -1208,7 +1320,8 @@ StyleKind IdentifierNamingCheck::findStyleKind(
         return SK_Constant;
     }
 
-    if (Decl->isParameterPack() && NamingStyles[SK_ParameterPack])
+    if (MayBeCPlusPlus && Decl->isParameterPack() &&
+        NamingStyles[SK_ParameterPack])
       return SK_ParameterPack;
 
     if (!Type.isNull() && Type.getTypePtr()->isAnyPointerType() &&
@@ -1228,7 +1341,8 @@ StyleKind IdentifierNamingCheck::findStyleKind(
       return SK_ConstexprVariable;
 
     if (!Type.isNull() && Type.isConstQualified()) {
-      if (Decl->isStaticDataMember() && NamingStyles[SK_ClassConstant])
+      if (MayBeCPlusPlus && Decl->isStaticDataMember() &&
+          NamingStyles[SK_ClassConstant])
         return SK_ClassConstant;
 
       if (Decl->isFileVarDecl() && Type.getTypePtr()->isAnyPointerType() &&
@@ -1255,7 +1369,8 @@ StyleKind IdentifierNamingCheck::findStyleKind(
         return SK_Constant;
     }
 
-    if (Decl->isStaticDataMember() && NamingStyles[SK_ClassMember])
+    if (MayBeCPlusPlus && Decl->isStaticDataMember() &&
+        NamingStyles[SK_ClassMember])
       return SK_ClassMember;
 
     if (Decl->isFileVarDecl() && Type.getTypePtr()->isAnyPointerType() &&
@@ -1284,53 +1399,56 @@ StyleKind IdentifierNamingCheck::findStyleKind(
     return SK_Invalid;
   }
 
-  if (const auto *Decl = dyn_cast<CXXMethodDecl>(D)) {
-    if (Decl->isMain() || !Decl->isUserProvided() ||
-        Decl->size_overridden_methods() > 0 || Decl->hasAttr<OverrideAttr>())
-      return SK_Invalid;
+  if constexpr (MayBeCPlusPlus) {
+    if (const auto *Decl = dyn_cast<CXXMethodDecl>(D)) {
+      if (Decl->isMain() || !Decl->isUserProvided() ||
+          Decl->size_overridden_methods() > 0 || Decl->hasAttr<OverrideAttr>())
+        return SK_Invalid;
 
-    // If this method has the same name as any base method, this is likely
-    // necessary even if it's not an override. e.g. CRTP.
-    for (const CXXBaseSpecifier &Base : Decl->getParent()->bases())
-      if (const auto *RD = Base.getType()->getAsCXXRecordDecl())
-        if (RD->hasMemberName(Decl->getDeclName()))
-          return SK_Invalid;
+      // If this method has the same name as any base method, this is likely
+      // necessary even if it's not an override. e.g. CRTP.
+      for (const CXXBaseSpecifier &Base : Decl->getParent()->bases())
+        if (const auto *RD = Base.getType()->getAsCXXRecordDecl())
+          if (RD->hasMemberName(Decl->getDeclName()))
+            return SK_Invalid;
 
-    if (Decl->isConstexpr() && NamingStyles[SK_ConstexprMethod])
-      return SK_ConstexprMethod;
+      if (Decl->isConstexpr() && NamingStyles[SK_ConstexprMethod])
+        return SK_ConstexprMethod;
 
-    if (Decl->isConstexpr() && NamingStyles[SK_ConstexprFunction])
-      return SK_ConstexprFunction;
+      if (Decl->isConstexpr() && NamingStyles[SK_ConstexprFunction])
+        return SK_ConstexprFunction;
 
-    if (Decl->isStatic() && NamingStyles[SK_ClassMethod])
-      return SK_ClassMethod;
+      if (Decl->isStatic() && NamingStyles[SK_ClassMethod])
+        return SK_ClassMethod;
 
-    if (Decl->isVirtual() && NamingStyles[SK_VirtualMethod])
-      return SK_VirtualMethod;
+      if (Decl->isVirtual() && NamingStyles[SK_VirtualMethod])
+        return SK_VirtualMethod;
 
-    if (Decl->getAccess() == AS_private && NamingStyles[SK_PrivateMethod])
-      return SK_PrivateMethod;
+      if (Decl->getAccess() == AS_private && NamingStyles[SK_PrivateMethod])
+        return SK_PrivateMethod;
 
-    if (Decl->getAccess() == AS_protected && NamingStyles[SK_ProtectedMethod])
-      return SK_ProtectedMethod;
+      if (Decl->getAccess() == AS_protected && NamingStyles[SK_ProtectedMethod])
+        return SK_ProtectedMethod;
 
-    if (Decl->getAccess() == AS_public && NamingStyles[SK_PublicMethod])
-      return SK_PublicMethod;
+      if (Decl->getAccess() == AS_public && NamingStyles[SK_PublicMethod])
+        return SK_PublicMethod;
 
-    if (NamingStyles[SK_Method])
-      return SK_Method;
+      if (NamingStyles[SK_Method])
+        return SK_Method;
 
-    if (NamingStyles[SK_Function])
-      return SK_Function;
+      if (NamingStyles[SK_Function])
+        return SK_Function;
 
-    return SK_Invalid;
+      return SK_Invalid;
+    }
   }
 
   if (const auto *Decl = dyn_cast<FunctionDecl>(D)) {
     if (Decl->isMain())
       return SK_Invalid;
 
-    if (Decl->isConstexpr() && NamingStyles[SK_ConstexprFunction])
+    if (MayBeCPlusPlus && Decl->isConstexpr() &&
+        NamingStyles[SK_ConstexprFunction])
       return SK_ConstexprFunction;
 
     if (Decl->isGlobal() && NamingStyles[SK_GlobalFunction])
@@ -1340,34 +1458,36 @@ StyleKind IdentifierNamingCheck::findStyleKind(
       return SK_Function;
   }
 
-  if (isa<TemplateTypeParmDecl>(D)) {
-    if (NamingStyles[SK_TypeTemplateParameter])
-      return SK_TypeTemplateParameter;
+  if constexpr (MayBeCPlusPlus) {
+    if (isa<TemplateTypeParmDecl>(D)) {
+      if (NamingStyles[SK_TypeTemplateParameter])
+        return SK_TypeTemplateParameter;
 
-    if (NamingStyles[SK_TemplateParameter])
-      return SK_TemplateParameter;
+      if (NamingStyles[SK_TemplateParameter])
+        return SK_TemplateParameter;
 
-    return SK_Invalid;
-  }
+      return SK_Invalid;
+    }
 
-  if (isa<NonTypeTemplateParmDecl>(D)) {
-    if (NamingStyles[SK_ValueTemplateParameter])
-      return SK_ValueTemplateParameter;
+    if (isa<NonTypeTemplateParmDecl>(D)) {
+      if (NamingStyles[SK_ValueTemplateParameter])
+        return SK_ValueTemplateParameter;
 
-    if (NamingStyles[SK_TemplateParameter])
-      return SK_TemplateParameter;
+      if (NamingStyles[SK_TemplateParameter])
+        return SK_TemplateParameter;
 
-    return SK_Invalid;
-  }
+      return SK_Invalid;
+    }
 
-  if (isa<TemplateTemplateParmDecl>(D)) {
-    if (NamingStyles[SK_TemplateTemplateParameter])
-      return SK_TemplateTemplateParameter;
+    if (isa<TemplateTemplateParmDecl>(D)) {
+      if (NamingStyles[SK_TemplateTemplateParameter])
+        return SK_TemplateTemplateParameter;
 
-    if (NamingStyles[SK_TemplateParameter])
-      return SK_TemplateParameter;
+      if (NamingStyles[SK_TemplateParameter])
+        return SK_TemplateParameter;
 
-    return SK_Invalid;
+      return SK_Invalid;
+    }
   }
 
   return SK_Invalid;
@@ -1380,12 +1500,16 @@ IdentifierNamingCheck::getFailureInfo(
     ArrayRef<std::optional<IdentifierNamingCheck::NamingStyle>> NamingStyles,
     const IdentifierNamingCheck::HungarianNotationOption &HNOption,
     StyleKind SK, const SourceManager &SM, bool IgnoreFailedSplit) const {
+  ++Counters.NamesChecked[SK];
   if (SK == SK_Invalid || !NamingStyles[SK])
     return std::nullopt;
 
   const IdentifierNamingCheck::NamingStyle &Style = *NamingStyles[SK];
-  if (Style.IgnoredRegexp.isValid() && Style.IgnoredRegexp.match(Name))
-    return std::nullopt;
+  if (Style.IgnoredRegexp.isValid()) {
+    ++Counters.RegexEvaluations;
+    if (Style.IgnoredRegexp.match(Name))
+      return std::nullopt;
+  }
 
   if (matchesStyle(Type, Name, Style, HNOption, ND))
     return std::nullopt;
@@ -1395,6 +1519,7 @@ IdentifierNamingCheck::getFailureInfo(
                     IdentifierNamingCheck::CT_LowerCase);
   std::replace(KindName.begin(), KindName.end(), '_', ' ');
 
+  ++Counters.FixupsComputed;
   std::string Fixup = fixupWithStyle(Type, Name, Style, HNOption, ND);
   if (StringRef(Fixup).equals(Name)) {
     if (!IgnoreFailedSplit) {
@@ -1412,23 +1537,130 @@ IdentifierNamingCheck::getFailureInfo(
 std::optional<RenamerClangTidyCheck::FailureInfo>
 IdentifierNamingCheck::getDeclFailureInfo(const NamedDecl *Decl,
                                           const SourceManager &SM) const {
+  CheckPerfCounters::Scope PerfScope(Perf);
+  if (hasReachedDiagnosticsCap() || isOverBudget(SM))
+    return std::nullopt;
+
+  llvm::TimeTraceScope TimeScope("getDeclFailureInfo",
+                                 [&] { return Decl->getNameAsString(); });
   SourceLocation Loc = Decl->getLocation();
+  // The renamer reports a failure at the declaration, fix-its included.
+  if (LineFilter.isFiltered(SM, Loc)) {
+    ++Counters.NamesFiltered;
+    return std::nullopt;
+  }
+  if (NoLints.isSuppressed(SM, Loc)) {
+    ++Counters.NamesSuppressed;
+    return std::nullopt;
+  }
   const FileStyle &FileStyle = getStyleForFile(SM.getFilename(Loc));
   if (!FileStyle.isActive())
     return std::nullopt;
 
-  return getFailureInfo(HungarianNotation.getDeclTypeName(Decl),
-                        Decl->getName(), Decl, Loc, FileStyle.getStyles(),
-                        FileStyle.getHNOption(),
-                        findStyleKind(Decl, FileStyle.getStyles(),
-                                      FileStyle.isIgnoringMainLikeFunction()),
-                        SM, IgnoreFailedSplit);
+  HeaderFailures *Recording = nullptr;
+  if (DeduplicateHeaderDiagnostics) {
+    if (HeaderState *State = lookupHeaderVerdict(SM, Loc)) {
+      if (!State->Replayed) {
+        Recording = &State->Recorded;
+      } else {
+        auto It = State->Replayed->find(
+            {SM.getFileOffset(Loc), Decl->getName().str()});
+        if (It != State->Replayed->end())
+          return countFailure(Decl, It->second);
+      }
+    }
+  }
+
+  std::optional<FailureInfo> Failure = getFailureInfo(
+      HungarianNotation.getDeclTypeName(Decl), Decl->getName(), Decl, Loc,
+      FileStyle.getStyles(), FileStyle.getHNOption(),
+      findStyleKind(Decl, FileStyle.getStyles(),
+                    FileStyle.isIgnoringMainLikeFunction()),
+      SM, IgnoreFailedSplit);
+  if (Recording)
+    Recording->try_emplace({SM.getFileOffset(Loc), Decl->getName().str()},
+                           Failure);
+  return countFailure(Decl, std::move(Failure));
+}
+
+// Counts \p Failure towards MaxDiagnosticsPerFile. Redeclarations share the
+// diagnostic of their canonical declaration, so they are counted once.
+std::optional<RenamerClangTidyCheck::FailureInfo>
+IdentifierNamingCheck::countFailure(const NamedDecl *Decl,
+                                    std::optional<FailureInfo> Failure) const {
+  if (Failure && MaxDiagnosticsPerFile != 0 &&
+      (!Decl || FailedDecls.insert(Decl->getCanonicalDecl()).second))
+    ++ReportedFailures;
+  return Failure;
+}
+
+// Polls the translation unit budget, reporting the first overrun. Names seen
+// after that are not checked.
+bool IdentifierNamingCheck::isOverBudget(const SourceManager &SM) const {
+  switch (Budget.update()) {
+  case TranslationUnitBudget::State::Within:
+    return false;
+  case TranslationUnitBudget::State::JustExceeded:
+    Context->diag(CheckName, BudgetExceededMessage) << Budget.describe();
+    Context->diag(CheckName, SM.getLocForStartOfFile(SM.getMainFileID()),
+                  BudgetExceededNote, DiagnosticIDs::Note);
+    return true;
+  case TranslationUnitBudget::State::Exceeded:
+    return true;
+  }
+  llvm_unreachable("unknown budget state");
+}
+
+// Returns the deduplication state of the header \p Loc is in, or null if
+// \p Loc is in the main file or in a macro expansion.
+IdentifierNamingCheck::HeaderState *
+IdentifierNamingCheck::lookupHeaderVerdict(const SourceManager &SM,
+                                           SourceLocation Loc) const {
+  if (!Loc.isFileID())
+    return nullptr;
+  const FileID FID = SM.getFileID(Loc);
+  if (FID == SM.getMainFileID())
+    return nullptr;
+
+  auto [It, Inserted] = Headers.try_emplace(FID);
+  HeaderState &State = It->second;
+  if (Inserted) {
+    // The style kinds of the declarations of a header depend on the language
+    // (e.g. records in C and C++) and on the branches the compile flags
+    // select. storeOptions() isn't const, but only reads the options.
+    if (!ContextFingerprint)
+      ContextFingerprint = llvm::hash_combine(
+          getOptionsFingerprint(const_cast<IdentifierNamingCheck &>(*this)),
+          getTranslationUnitFingerprint(getLangOpts(), SM));
+    // With per-directory configuration, the styles of the header depend on
+    // where it is, not only on its contents.
+    uint64_t OptionsKey = *ContextFingerprint;
+    if (GetConfigPerFile)
+      OptionsKey = llvm::hash_combine(
+          *ContextFingerprint,
+          llvm::sys::path::parent_path(SM.getFilename(Loc)));
+    State.Key = {hashHeaderContents(SM.getBufferData(FID)), OptionsKey};
+    State.Replayed =
+        HeaderVerdictStore<HeaderFailures>::instance().lookup(State.Key);
+  }
+  return &State;
 }
 
 std::optional<RenamerClangTidyCheck::FailureInfo>
 IdentifierNamingCheck::getMacroFailureInfo(const Token &MacroNameTok,
                                            const SourceManager &SM) const {
+  if (hasReachedDiagnosticsCap() || isOverBudget(SM))
+    return std::nullopt;
+
   SourceLocation Loc = MacroNameTok.getLocation();
+  if (LineFilter.isFiltered(SM, Loc)) {
+    ++Counters.NamesFiltered;
+    return std::nullopt;
+  }
+  if (NoLints.isSuppressed(SM, Loc)) {
+    ++Counters.NamesSuppressed;
+    return std::nullopt;
+  }
   const FileStyle &Style = getStyleForFile(SM.getFilename(Loc));
   if (!Style.isActive())
     return std::nullopt;
@@ -1441,20 +1673,47 @@ IdentifierNamingCheck::getMacroFailureInfo(const Token &MacroNameTok,
 RenamerClangTidyCheck::DiagInfo
 IdentifierNamingCheck::getDiagInfo(const NamingCheckId &ID,
                                    const NamingCheckFailure &Failure) const {
+  if (Statistics.accountsMemory())
+    Memory.FailureBytes +=
+        sizeof(std::pair<NamingCheckId, NamingCheckFailure>) +
+        getHeapBytes(ID.second) + getHeapBytes(Failure.Info.KindName) +
+        getHeapBytes(Failure.Info.Fixup) +
+        Failure.RawUsageLocs.getMemorySize();
   return DiagInfo{"invalid case style for %0 '%1'",
                   [&](DiagnosticBuilder &Diag) {
                     Diag << Failure.Info.KindName << ID.second;
                   }};
 }
 
+const IdentifierNamingCheck::FileStyle &
+IdentifierNamingCheck::getMainFileStyle() const {
+  if (MainFileStyle)
+    return *MainFileStyle;
+  llvm::TimeTraceScope TimeScope("ParseOptions", CheckName);
+  // The directory of the main file has the options of the check.
+  auto IterAndInserted = NamingStylesCache.try_emplace(
+      llvm::sys::path::parent_path(MainFile), getFileStyleFromOptions(Options));
+  assert(IterAndInserted.second && "Couldn't insert Style");
+  // Holding a reference to the data in the map is safe as it should never
+  // move.
+  MainFileStyle = &IterAndInserted.first->getValue();
+  return *MainFileStyle;
+}
+
 const IdentifierNamingCheck::FileStyle &
 IdentifierNamingCheck::getStyleForFile(StringRef FileName) const {
   if (!GetConfigPerFile)
-    return *MainFileStyle;
+    return getMainFileStyle();
+  llvm::TimeTraceScope TimeScope("getStyleForFile", FileName);
   StringRef Parent = llvm::sys::path::parent_path(FileName);
   auto Iter = NamingStylesCache.find(Parent);
-  if (Iter != NamingStylesCache.end())
+  if (Iter != NamingStylesCache.end()) {
+    ++Counters.StyleCacheHits;
     return Iter->getValue();
+  }
+  ++Counters.StyleCacheMisses;
+  if (Parent == llvm::sys::path::parent_path(MainFile))
+    return getMainFileStyle();
 
   ClangTidyOptions Options = Context->getOptionsForFile(FileName);
   if (Options.Checks && GlobList(*Options.Checks).contains(CheckName)) {
@@ -1470,6 +1729,15 @@ IdentifierNamingCheck::getStyleForFile(StringRef FileName) const {
   return It.first->getValue();
 }
 
+template StyleKind IdentifierNamingCheck::findStyleKindFor<CLanguagePolicy>(
+    const NamedDecl *D,
+    ArrayRef<std::optional<IdentifierNamingCheck::NamingStyle>> NamingStyles,
+    bool IgnoreMainLikeFunctions) const;
+template StyleKind IdentifierNamingCheck::findStyleKindFor<AnyLanguagePolicy>(
+    const NamedDecl *D,
+    ArrayRef<std::optional<IdentifierNamingCheck::NamingStyle>> NamingStyles,
+    bool IgnoreMainLikeFunctions) const;
+
 } // namespace caos
 } // namespace tidy
 } // namespace clang
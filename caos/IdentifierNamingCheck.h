@@ -10,6 +10,20 @@
 #define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_READABILITY_IDENTIFIERNAMINGCHECK_H
 
 #include "../clang-tidy/utils/RenamerClangTidyCheck.h"
+#include "CheckPerfCounters.h"
+#include "CheckStatistics.h"
+#include "HeaderVerdictStore.h"
+#include "LanguagePolicy.h"
+#include "LineFilterIndex.h"
+#include "NoLintIndex.h"
+#include "TranslationUnitBudget.h"
+#include "TranslationUnitTrace.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
 namespace clang {
 namespace tidy {
 namespace caos {
@@ -29,7 +43,10 @@ enum StyleKind : int;
 /// different rules for different kind of identifier. In general, the
 /// rules are falling back to a more generic rule if the specific case is not
 /// configured.
-class IdentifierNamingCheck final : public RenamerClangTidyCheck {
+///
+/// The kinds of the declarations are told apart by \c IdentifierNamingCheckFor,
+/// the instantiation for the language of the translation unit.
+class IdentifierNamingCheck : public RenamerClangTidyCheck {
 public:
   IdentifierNamingCheck(StringRef Name, ClangTidyContext *Context);
   ~IdentifierNamingCheck();
@@ -165,7 +182,16 @@ public:
                  const IdentifierNamingCheck::HungarianNotationOption &HNOption,
                  const Decl *D) const;
 
-  StyleKind findStyleKind(
+  virtual StyleKind findStyleKind(
+      const NamedDecl *D,
+      ArrayRef<std::optional<IdentifierNamingCheck::NamingStyle>> NamingStyles,
+      bool IgnoreMainLikeFunctions) const = 0;
+
+  /// \c findStyleKind without the declaration kinds of the languages
+  /// \p LanguagePolicy excludes. Instantiated for the policies of
+  /// LanguagePolicy.h.
+  template <typename LanguagePolicy>
+  StyleKind findStyleKindFor(
       const NamedDecl *D,
       ArrayRef<std::optional<IdentifierNamingCheck::NamingStyle>> NamingStyles,
       bool IgnoreMainLikeFunctions) const;
@@ -191,18 +217,111 @@ private:
                        const NamingCheckFailure &Failure) const override;
 
   const FileStyle &getStyleForFile(StringRef FileName) const;
+  const FileStyle &getMainFileStyle() const;
+
+  /// Results of \c getDeclFailureInfo for the declarations of a header,
+  /// keyed by their offset and name.
+  using HeaderFailures =
+      std::map<std::pair<unsigned, std::string>, std::optional<FailureInfo>>;
+
+  struct HeaderState {
+    HeaderVerdictKey Key;
+    /// Failures published by an earlier translation unit, if any.
+    std::shared_ptr<const HeaderFailures> Replayed;
+    HeaderFailures Recorded;
+  };
+
+  HeaderState *lookupHeaderVerdict(const SourceManager &SM,
+                                   SourceLocation Loc) const;
+
+  bool isOverBudget(const SourceManager &SM) const;
+
+  std::optional<FailureInfo>
+  countFailure(const NamedDecl *Decl,
+               std::optional<FailureInfo> Failure) const;
+
+  void addMemoryCounters(StatisticsCounters &Values) const;
+
+  bool hasReachedDiagnosticsCap() const {
+    return MaxDiagnosticsPerFile != 0 &&
+           ReportedFailures >= MaxDiagnosticsPerFile;
+  }
 
+  // Declared first, so that its construction event covers the other members.
+  const TranslationUnitTrace Trace;
   /// Stores the style options as a vector, indexed by the specified \ref
   /// StyleKind, for a given directory.
   mutable llvm::StringMap<FileStyle> NamingStylesCache;
-  FileStyle *MainFileStyle;
+  /// The style from the options of the check, built on first use: many
+  /// translation units have no name to check.
+  mutable FileStyle *MainFileStyle = nullptr;
   ClangTidyContext *Context;
   const StringRef CheckName;
   const bool GetConfigPerFile;
   const bool IgnoreFailedSplit;
+  const bool DeduplicateHeaderDiagnostics;
+  /// The fingerprints of the options and of the translation unit, combined
+  /// for the first header whose failures are looked up.
+  mutable std::optional<uint64_t> ContextFingerprint;
+  mutable llvm::DenseMap<FileID, HeaderState> Headers;
+  const unsigned TimeBudgetMs;
+  const unsigned MemoryBudgetMiB;
+  // Once this many names have failed, the rest of the translation unit is
+  // skipped. 0 means no limit.
+  const unsigned MaxDiagnosticsPerFile;
+  mutable TranslationUnitBudget Budget;
+  mutable llvm::SmallPtrSet<const Decl *, 8> FailedDecls;
+  mutable unsigned ReportedFailures = 0;
+
+  /// Hot-path counters for the current translation unit.
+  struct {
+    /// Indexed by \ref StyleKind.
+    std::vector<uint64_t> NamesChecked;
+    uint64_t NamesSuppressed = 0;
+    uint64_t NamesFiltered = 0;
+    uint64_t RegexEvaluations = 0;
+    uint64_t FixupsComputed = 0;
+    uint64_t StyleCacheHits = 0;
+    uint64_t StyleCacheMisses = 0;
+  } mutable Counters;
+  const StatisticsOptions Statistics;
+  const CheckPerfCounters Perf;
+  const std::string MainFile;
+  /// Where NOLINT comments suppress this check, so that the names of
+  /// suppressed declarations and macros are not checked.
+  mutable NoLintIndex NoLints;
+  /// The lines clang-tidy keeps diagnostics on. The failure of a name is
+  /// reported at its declaration, so only the names declared on them are
+  /// checked; their usages are collected wherever they are.
+  mutable LineFilterIndex LineFilter;
+
+  /// Memory accounting for the current translation unit, if enabled.
+  struct {
+    uint64_t InitialPeakResidentBytes = 0;
+    /// Bytes of the failures collected by the base class, with their usage
+    /// sets. Summed as they are diagnosed, which is the only time this class
+    /// sees them.
+    uint64_t FailureBytes = 0;
+  } mutable Memory;
   HungarianNotation HungarianNotation;
 };
 
+/// \c IdentifierNamingCheck for the translation units \p LanguagePolicy
+/// allows.
+template <typename LanguagePolicy>
+class IdentifierNamingCheckFor final : public IdentifierNamingCheck {
+public:
+  using IdentifierNamingCheck::IdentifierNamingCheck;
+
+  StyleKind findStyleKind(
+      const NamedDecl *D,
+      ArrayRef<std::optional<IdentifierNamingCheck::NamingStyle>> NamingStyles,
+      bool IgnoreMainLikeFunctions) const override {
+    return findStyleKindFor<LanguagePolicy>(D, NamingStyles,
+                                            IgnoreMainLikeFunctions);
+  }
+};
+
 } // namespace caos
 template <>
 struct OptionEnumMapping<caos::IdentifierNamingCheck::CaseType> {
@@ -0,0 +1,51 @@
+//===--- LanguagePolicy.h - clang-tidy --------------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_LANGUAGEPOLICY_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_LANGUAGEPOLICY_H
+
+#include "clang/Basic/LangOptions.h"
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+/// Language policies the checks are instantiated with. A policy states which
+/// languages a translation unit may be written in, so that the instantiation
+/// for C compiles the handling of C++ and Objective-C constructs out instead
+/// of testing for them on every node.
+
+/// Plain C: the course code.
+struct CLanguagePolicy {
+  static constexpr bool MayBeCPlusPlus = false;
+  static constexpr bool MayBeObjC = false;
+};
+
+/// Any language; the \c LangOptions of the translation unit decide.
+struct AnyLanguagePolicy {
+  static constexpr bool MayBeCPlusPlus = true;
+  static constexpr bool MayBeObjC = true;
+};
+
+/// Whether the translation unit is C++, folded to false for a policy that
+/// excludes it.
+template <typename LanguagePolicy>
+bool isCPlusPlus(const LangOptions &LangOpts) {
+  return LanguagePolicy::MayBeCPlusPlus && LangOpts.CPlusPlus;
+}
+
+/// Whether \c CLanguagePolicy covers a translation unit with \p LangOpts.
+inline bool isPlainC(const LangOptions &LangOpts) {
+  return !LangOpts.CPlusPlus && !LangOpts.ObjC;
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_LANGUAGEPOLICY_H
@@ -0,0 +1,70 @@
+//===--- LineFilterIndex.cpp - clang-tidy ---------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "LineFilterIndex.h"
+#include "llvm/ADT/STLExtras.h"
+#include <algorithm>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+// Matches the file as ClangTidyDiagnosticConsumer::passesLineFilter does: the
+// first entry whose name ends the file name applies, and a file without one
+// has all its diagnostics dropped.
+LineFilterIndex::Lines LineFilterIndex::getLines(StringRef FileName) const {
+  const auto It = llvm::find_if(Filter, [FileName](const FileFilter &Entry) {
+    return FileName.endswith(Entry.Name);
+  });
+  if (It == Filter.end())
+    return std::vector<FileFilter::LineRange>();
+  if (It->LineRanges.empty())
+    return std::nullopt;
+
+  std::vector<FileFilter::LineRange> Ranges = It->LineRanges;
+  llvm::sort(Ranges);
+  std::vector<FileFilter::LineRange> Merged;
+  for (const FileFilter::LineRange &Range : Ranges) {
+    if (!Merged.empty() && Range.first <= Merged.back().second)
+      Merged.back().second = std::max(Merged.back().second, Range.second);
+    else
+      Merged.push_back(Range);
+  }
+  return Merged;
+}
+
+bool LineFilterIndex::isFiltered(const SourceManager &SM, SourceLocation Loc) {
+  if (Filter.empty() || Loc.isInvalid())
+    return false;
+  const auto [FID, Offset] = SM.getDecomposedExpansionLoc(Loc);
+
+  auto It = Files.find(FID);
+  if (It == Files.end()) {
+    // clang-tidy keeps the diagnostics in buffers without a file, such as
+    // the predefines.
+    const FileEntry *File = SM.getFileEntryForID(FID);
+    It = Files.try_emplace(FID, File ? getLines(File->getName()) : Lines())
+             .first;
+  }
+  if (!It->second)
+    return false;
+
+  const std::vector<FileFilter::LineRange> &Ranges = *It->second;
+  if (Ranges.empty())
+    return true;
+  const unsigned Line = SM.getLineNumber(FID, Offset);
+  auto After = llvm::upper_bound(
+      Ranges, Line, [](unsigned L, const FileFilter::LineRange &Range) {
+        return L < Range.first;
+      });
+  return After == Ranges.begin() || Line > std::prev(After)->second;
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
@@ -0,0 +1,58 @@
+//===--- LineFilterIndex.h - clang-tidy -------------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_LINEFILTERINDEX_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_LINEFILTERINDEX_H
+
+#include "../clang-tidy/ClangTidyOptions.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/DenseMap.h"
+#include <optional>
+#include <vector>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+/// The lines of the files of a translation unit on which clang-tidy's line
+/// filter (--line-filter, or the changed lines caos-batch reads from a diff)
+/// keeps diagnostics.
+///
+/// clang-tidy only applies the filter once a diagnostic has been built, so a
+/// resubmission with a few changed lines would cost as much to check as the
+/// first submission. Checks look their findings up here first instead: on the
+/// first lookup in a file, the ranges of its filter entry are merged, and each
+/// lookup is then a binary search. As in clang-tidy, a location in a macro
+/// expansion counts where the macro is expanded.
+class LineFilterIndex {
+public:
+  explicit LineFilterIndex(const ClangTidyGlobalOptions &Options)
+      : Filter(Options.LineFilter) {}
+
+  /// Whether clang-tidy will drop a diagnostic at \p Loc.
+  bool isFiltered(const SourceManager &SM, SourceLocation Loc);
+
+  /// Forgets the files of the current translation unit.
+  void clear() { Files.clear(); }
+
+private:
+  /// The sorted, disjoint line ranges diagnostics are kept on; unset if they
+  /// are kept on every line.
+  using Lines = std::optional<std::vector<FileFilter::LineRange>>;
+
+  Lines getLines(StringRef FileName) const;
+
+  const std::vector<FileFilter> &Filter;
+  llvm::DenseMap<FileID, Lines> Files;
+};
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_LINEFILTERINDEX_H
@@ -22,19 +22,29 @@
 #include "clang/AST/ASTContext.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/TimeProfiler.h"
 #include <algorithm>
+#include <atomic>
 
 using namespace clang::ast_matchers;
 
 namespace clang {
 
+template <typename LanguagePolicy>
 static bool isUsedToInitializeAConstant(
-    const MatchFinder::MatchResult &Result, const DynTypedNode &Node,
-    bool LangIsCpp,
-    tidy::caos::MagicNumbersCheck::LiteralUsageInfo &UsageInfo) {
+    ASTContext &Ctx, const DynTypedNode &Node, bool LangIsCpp,
+    tidy::caos::MagicNumbersCheck::LiteralUsageInfo &UsageInfo,
+    uint64_t &NodesVisited) {
   using tidy::caos::MagicNumbersCheck;
 
+  ++NodesVisited;
+
   const auto *AsInitList = Node.get<InitListExpr>();
   if (AsInitList) {
     UsageInfo.IsUsedInInitializerList = true;
@@ -43,7 +53,8 @@ static bool isUsedToInitializeAConstant(
     if (AsDecl) {
       if (AsDecl->getType().isConstQualified()) {
         UsageInfo.Category =
-            LangIsCpp ? MagicNumbersCheck::ConstCategory::TRUE_CONST
+            LanguagePolicy::MayBeCPlusPlus && LangIsCpp
+                ? MagicNumbersCheck::ConstCategory::TRUE_CONST
                       : MagicNumbersCheck::ConstCategory::RUNTIME_CONST;
         return true;
       }
@@ -63,22 +74,25 @@ static bool isUsedToInitializeAConstant(
   }
 
   return llvm::any_of(
-      Result.Context->getParents(Node),
-      [&Result, &UsageInfo, LangIsCpp](const DynTypedNode &Parent) {
-        return isUsedToInitializeAConstant(Result, Parent, LangIsCpp,
-                                           UsageInfo);
+      Ctx.getParents(Node),
+      [&Ctx, &UsageInfo, LangIsCpp, &NodesVisited](
+          const DynTypedNode &Parent) {
+        return isUsedToInitializeAConstant<LanguagePolicy>(
+            Ctx, Parent, LangIsCpp, UsageInfo, NodesVisited);
       });
 }
 
-static bool isUsedToDefineABitField(const MatchFinder::MatchResult &Result,
-                                    const DynTypedNode &Node) {
+static bool isUsedToDefineABitField(ASTContext &Ctx, const DynTypedNode &Node,
+                                    uint64_t &NodesVisited) {
+  ++NodesVisited;
   const auto *AsFieldDecl = Node.get<FieldDecl>();
   if (AsFieldDecl && AsFieldDecl->isBitField())
     return true;
 
-  return llvm::any_of(Result.Context->getParents(Node),
-                      [&Result](const DynTypedNode &Parent) {
-                        return isUsedToDefineABitField(Result, Parent);
+  return llvm::any_of(Ctx.getParents(Node),
+                      [&Ctx, &NodesVisited](const DynTypedNode &Parent) {
+                        return isUsedToDefineABitField(Ctx, Parent,
+                                                       NodesVisited);
                       });
 }
 
@@ -95,18 +109,41 @@ const char DefaultIgnoredFunctionArgs[] = "strtol;3;d;strtoll;3;d";
 
 MagicNumbersCheck::MagicNumbersCheck(StringRef Name, ClangTidyContext *Context)
     : ClangTidyCheck(Name, Context),
+      Trace(Options, Name, Context->getCurrentFile()),
+      CheckSystemHeaders(Context->getOptions().SystemHeaders.value_or(false)),
       IgnoreAllFloatingPointValues(
           Options.get("IgnoreAllFloatingPointValues", false)),
       IgnoreBitFieldsWidths(Options.get("IgnoreBitFieldsWidths", true)),
       IgnorePowersOf2IntegerValues(
           Options.get("IgnorePowersOf2IntegerValues", false)),
       IgnoreStrtolBases(Options.get("IgnoreStrtolBases", false)),
+      DeduplicateHeaderDiagnostics(
+          Options.get("DeduplicateHeaderDiagnostics", false)),
       RawIgnoredIntegerValues(
           Options.get("IgnoredIntegerValues", DefaultIgnoredIntegerValues)),
       RawIgnoredFloatingPointValues(Options.get(
           "IgnoredFloatingPointValues", DefaultIgnoredFloatingPointValues)),
       RawIgnoredFunctionArgs(
-          Options.get("IgnoredFunctionArgs", DefaultIgnoredFunctionArgs)) {
+          Options.get("IgnoredFunctionArgs", DefaultIgnoredFunctionArgs)),
+      TimeBudgetMs(Options.getLocalOrGlobal("TimeBudgetMs", 0U)),
+      MemoryBudgetMiB(Options.getLocalOrGlobal("MemoryBudgetMiB", 0U)),
+      MaxDiagnosticsPerFile(
+          Options.getLocalOrGlobal("MaxDiagnosticsPerFile", 0U)),
+      ParallelJobs(Options.getLocalOrGlobal("ParallelJobs", 0U)),
+      Budget(TimeBudgetMs, MemoryBudgetMiB), Statistics(Options),
+      Perf(Options), MainFile(Context->getCurrentFile()), NoLints(Name),
+      LineFilter(Context->getGlobalOptions()) {
+  if (Statistics.accountsMemory())
+    Memory.InitialPeakResidentBytes = getPeakResidentBytes();
+  Trace.endConstruction();
+}
+
+// The option lists are only needed once there is a literal to check, which
+// many translation units (headers, declarations only) never have.
+void MagicNumbersCheck::parseOptionLists() {
+  llvm::TimeTraceScope TimeScope("ParseOptions", "caos-magic-numbers");
+  OptionListsParsed = true;
+
   // Process the set of ignored integer values.
   const std::vector<StringRef> IgnoredIntegerValuesInput =
       utils::options::parseStringList(RawIgnoredIntegerValues);
@@ -229,10 +266,19 @@ void MagicNumbersCheck::storeOptions(ClangTidyOptions::OptionMap &Opts) {
   Options.store(Opts, "IgnorePowersOf2IntegerValues",
                 IgnorePowersOf2IntegerValues);
   Options.store(Opts, "IgnoreStrtolBases", IgnoreStrtolBases);
+  Options.store(Opts, "DeduplicateHeaderDiagnostics",
+                DeduplicateHeaderDiagnostics);
   Options.store(Opts, "IgnoredIntegerValues", RawIgnoredIntegerValues);
   Options.store(Opts, "IgnoredFloatingPointValues",
                 RawIgnoredFloatingPointValues);
   Options.store(Opts, "IgnoredFunctionArgs", RawIgnoredFunctionArgs);
+  Options.store(Opts, "TimeBudgetMs", TimeBudgetMs);
+  Options.store(Opts, "MemoryBudgetMiB", MemoryBudgetMiB);
+  Options.store(Opts, "MaxDiagnosticsPerFile", MaxDiagnosticsPerFile);
+  Options.store(Opts, "ParallelJobs", ParallelJobs);
+  Statistics.store(Options, Opts);
+  Perf.store(Options, Opts);
+  Trace.store(Options, Opts);
 }
 
 void MagicNumbersCheck::registerMatchers(MatchFinder *Finder) {
@@ -241,27 +287,180 @@ void MagicNumbersCheck::registerMatchers(MatchFinder *Finder) {
     Finder->addMatcher(floatLiteral().bind("float"), this);
 }
 
-void MagicNumbersCheck::check(const MatchFinder::MatchResult &Result) {
+template <typename LanguagePolicy, typename L>
+void MagicNumbersCheck::onLiteral(ASTContext &Ctx, const L &Literal) {
+  if (!CheckSystemHeaders &&
+      Ctx.getSourceManager().isInSystemHeader(Literal.getLocation()))
+    return;
+  CheckPerfCounters::Scope PerfScope(Perf);
+  if (hasReachedDiagnosticsCap() ||
+      isOverBudget(Ctx.getSourceManager(), Budget.update()))
+    return;
+
+  llvm::TimeTraceScope TimeScope("checkLiteral", [&] {
+    return Literal.getExprLoc().printToString(Ctx.getSourceManager());
+  });
+  TraversalKindScope RAII(Ctx, TK_AsIs);
+
+  if (Statistics.accountsMemory() && !Memory.ParentMapBytes)
+    measureParentMap(Ctx, Literal);
+
+  if (!OptionListsParsed)
+    parseOptionLists();
+  checkLiteral<LanguagePolicy>(Ctx, Literal);
+}
+
+// Reports the first overrun of the budget, as polled into \p State. Literals
+// seen after that are not checked.
+bool MagicNumbersCheck::isOverBudget(const SourceManager &SM,
+                                     TranslationUnitBudget::State State) {
+  switch (State) {
+  case TranslationUnitBudget::State::Within:
+    return false;
+  case TranslationUnitBudget::State::JustExceeded:
+    diag(BudgetExceededMessage) << Budget.describe();
+    diag(SM.getLocForStartOfFile(SM.getMainFileID()), BudgetExceededNote,
+         DiagnosticIDs::Note);
+    return true;
+  case TranslationUnitBudget::State::Exceeded:
+    return true;
+  }
+  llvm_unreachable("unknown budget state");
+}
+
+void MagicNumbersCheck::onEndOfTranslationUnit() {
+  llvm::TimeTraceScope TimeScope("EndOfTranslationUnit", "caos-magic-numbers");
+  StatisticsCounters Values = {
+      {"literals_matched", Counters.LiteralsMatched},
+      {"literals_suppressed", Counters.LiteralsSuppressed},
+      {"literals_filtered", Counters.LiteralsFiltered},
+      {"parent_nodes_visited", Counters.ParentNodesVisited},
+      {"function_arg_lookups", Counters.FunctionArgLookups},
+      {"radix_lexes", Counters.RadixLexes}};
+  if (Statistics.accountsMemory()) {
+    Values.emplace_back("memory.parent_map_bytes",
+                        Memory.ParentMapBytes.value_or(0));
+    addPeakResidentCounters(Values, Memory.InitialPeakResidentBytes);
+    Memory.InitialPeakResidentBytes = getPeakResidentBytes();
+    Memory.ParentMapBytes.reset();
+  }
+  if (Perf.isEnabled())
+    Perf.addCounters(Values);
+  Statistics.report("caos-magic-numbers", MainFile, Values);
+  Counters = {};
+  NoLints.clear();
+  LineFilter.clear();
+
+  // Publish the findings of the headers analysed in this translation unit,
+  // unless the analysis was cut short and they may be incomplete.
+  if (Budget.isExceeded() || hasReachedDiagnosticsCap()) {
+    Headers.clear();
+    return;
+  }
+  for (auto &[FID, State] : Headers)
+    if (!State.IsReplayed)
+      HeaderVerdictStore<HeaderFindings>::instance().insert(
+          State.Key, std::move(State.Findings));
+  Headers.clear();
+}
 
-  TraversalKindScope RAII(*Result.Context, TK_AsIs);
+void MagicNumbersCheck::reportFinding(const SourceManager &SM,
+                                      SourceLocation Loc, FindingKind Kind,
+                                      StringRef LiteralText,
+                                      HeaderFindings *Recording) {
+  // Replayed headers report all their findings at once.
+  if (hasReachedDiagnosticsCap())
+    return;
+  ++ReportedDiagnostics;
+
+  switch (Kind) {
+  case FindingKind::RUNTIME_CONST_INTEGER:
+    diag(Loc, "'const' in C is not a compile-time constant; consider using an "
+              "enum for integer constants");
+    break;
+  case FindingKind::RUNTIME_CONST_FLOAT:
+    diag(Loc, "'const' in C is not a compile-time constant; consider using a "
+              "#define for floating-point constants");
+    break;
+  case FindingKind::MAGIC_NUMBER:
+    diag(Loc,
+         "%0 is a magic number; consider replacing it with a named constant")
+        << LiteralText;
+    break;
+  }
 
-  checkBoundMatch<IntegerLiteral>(Result, "integer");
-  checkBoundMatch<FloatingLiteral>(Result, "float");
+  if (Recording)
+    Recording->push_back({SM.getFileOffset(Loc), Kind, LiteralText.str()});
 }
 
-static bool isAnotherKindOfConstant(
-    const clang::ast_matchers::MatchFinder::MatchResult &Result,
-    const DynTypedNode &Node) {
+// Returns false if \p Loc is in a header whose findings have been replayed
+// from the store, so the literal doesn't need to be analysed. Otherwise sets
+// \p Recording to the findings of the header being recorded, if any.
+bool MagicNumbersCheck::lookupHeaderVerdict(const SourceManager &SM,
+                                            SourceLocation Loc,
+                                            HeaderFindings *&Recording) {
+  Recording = nullptr;
+  // Literals spelled in macro arguments depend on the expansion site.
+  if (!Loc.isFileID())
+    return true;
+  const FileID FID = SM.getFileID(Loc);
+  if (FID == SM.getMainFileID())
+    return true;
+
+  auto [It, Inserted] = Headers.try_emplace(FID);
+  HeaderState &State = It->second;
+  if (Inserted) {
+    // The literals of a header, and so its findings, depend on the language
+    // and on the macros predefined by the compile flags.
+    if (!ContextFingerprint)
+      ContextFingerprint =
+          llvm::hash_combine(getOptionsFingerprint(*this),
+                             getTranslationUnitFingerprint(getLangOpts(), SM));
+    State.Key = {hashHeaderContents(SM.getBufferData(FID)),
+                 *ContextFingerprint};
+    if (std::shared_ptr<const HeaderFindings> Stored =
+            HeaderVerdictStore<HeaderFindings>::instance().lookup(State.Key)) {
+      State.IsReplayed = true;
+      for (const Finding &F : *Stored)
+        reportFinding(SM, SM.getComposedLoc(FID, F.Offset), F.Kind,
+                      F.LiteralText, /*Recording=*/nullptr);
+    }
+  }
+
+  if (State.IsReplayed)
+    return false;
+  Recording = &State.Findings;
+  return true;
+}
+
+// The first parent lookup builds the parent map of the whole AST, so the heap
+// growth around it is the memory the check costs the ASTContext. It is 0 when
+// another check has built the map already.
+void MagicNumbersCheck::measureParentMap(ASTContext &Ctx,
+                                         const Expr &Literal) {
+  const size_t Before = llvm::sys::Process::GetMallocUsage();
+  Ctx.getParents(Literal);
+  const size_t After = llvm::sys::Process::GetMallocUsage();
+  Memory.ParentMapBytes = After > Before ? After - Before : 0;
+}
+
+template <typename LanguagePolicy>
+static bool isAnotherKindOfConstant(ASTContext &Ctx,
+                                    const DynTypedNode &Node) {
   // Some checks from original readability-magic-numbers.
   // If any of them returns true, the constant is considered a "true"
   // (compile-time) constant. This may not always be the case, but distinction
   // between categories is used only to ban numeric constants marked with
   // "const" in C.
 
+  // All of them look for templates and user defined literals.
+  if constexpr (!LanguagePolicy::MayBeCPlusPlus)
+    return false;
+
   // Ignore this instance, because this matches an
   // expanded class enumeration value.
   if (Node.get<CStyleCastExpr>() &&
-      llvm::any_of(Result.Context->getParents(Node),
+      llvm::any_of(Ctx.getParents(Node),
                    [](const DynTypedNode &GrandParent) {
                      return GrandParent.get<SubstNonTypeTemplateParmExpr>() !=
                             nullptr;
@@ -283,18 +482,23 @@ static bool isAnotherKindOfConstant(
   return false;
 }
 
-MagicNumbersCheck::LiteralUsageInfo MagicNumbersCheck::getUsageInfo(
-    const clang::ast_matchers::MatchFinder::MatchResult &Result,
-    const clang::Expr &ExprResult) const {
+template <typename LanguagePolicy>
+MagicNumbersCheck::LiteralUsageInfo
+MagicNumbersCheck::getUsageInfo(ASTContext &Ctx,
+                                const clang::Expr &ExprResult,
+                                HotCounters &Counts) const {
   LiteralUsageInfo UsageInfo;
-
-  llvm::any_of(Result.Context->getParents(ExprResult),
-               [this, &Result, &UsageInfo](const DynTypedNode &Parent) {
-                 if (isUsedToInitializeAConstant(
-                         Result, Parent, getLangOpts().CPlusPlus, UsageInfo))
+  const bool LangIsCpp = isCPlusPlus<LanguagePolicy>(getLangOpts());
+
+  llvm::any_of(Ctx.getParents(ExprResult),
+               [&Ctx, &UsageInfo, &Counts,
+                LangIsCpp](const DynTypedNode &Parent) {
+                 if (isUsedToInitializeAConstant<LanguagePolicy>(
+                         Ctx, Parent, LangIsCpp, UsageInfo,
+                         Counts.ParentNodesVisited))
                    return true;
 
-                 if (isAnotherKindOfConstant(Result, Parent)) {
+                 if (isAnotherKindOfConstant<LanguagePolicy>(Ctx, Parent)) {
                    UsageInfo.Category = ConstCategory::TRUE_CONST;
                    return true;
                  }
@@ -350,48 +554,37 @@ bool MagicNumbersCheck::isSyntheticValue(const SourceManager *SourceManager,
   return BufferIdentifier.empty();
 }
 
-bool MagicNumbersCheck::isBitFieldWidth(
-    const clang::ast_matchers::MatchFinder::MatchResult &Result,
-    const IntegerLiteral &Literal) const {
+bool MagicNumbersCheck::isBitFieldWidth(ASTContext &Ctx,
+                                        const IntegerLiteral &Literal,
+                                        HotCounters &Counts) const {
   return IgnoreBitFieldsWidths &&
-         llvm::any_of(Result.Context->getParents(Literal),
-                      [&Result](const DynTypedNode &Parent) {
-                        return isUsedToDefineABitField(Result, Parent);
+         llvm::any_of(Ctx.getParents(Literal),
+                      [&Ctx, &Counts](const DynTypedNode &Parent) {
+                        return isUsedToDefineABitField(
+                            Ctx, Parent, Counts.ParentNodesVisited);
                       });
 }
 
-bool MagicNumbersCheck::isIgnoredFunctionArg(
-    const clang::ast_matchers::MatchFinder::MatchResult &Result,
-    const IntegerLiteral &Literal) const {
-  if (IgnoredFunctionArgs.empty()) {
-    return false;
-  }
-  return llvm::any_of(Result.Context->getParents(Literal),
-                      [&, this](const DynTypedNode &Parent) {
-                        return isIgnoredFunctionArgImpl(
-                            Result, Parent, DynTypedNode::create(Literal),
-                            Literal);
-                      });
-}
-
-bool MagicNumbersCheck::isIgnoredFunctionArgImpl(
-    const MatchFinder::MatchResult &Result, const DynTypedNode &Node,
-    const DynTypedNode &Child, const IntegerLiteral &Literal) const {
+// Collects the entries of IgnoredFunctionArgs for the calls \p Child is an
+// argument of, looking through the non-call ancestors of \p Node.
+void MagicNumbersCheck::findIgnoredFunctionArgs(
+    ASTContext &Ctx, const DynTypedNode &Node, const DynTypedNode &Child,
+    HotCounters &Counts,
+    llvm::SmallVectorImpl<const IgnoredFunctionArg *> &Matches) const {
+  ++Counts.ParentNodesVisited;
   const auto *AsCallExpr = Node.get<CallExpr>();
   if (!AsCallExpr) {
     // In some cases a node can have multiple parents, so it's better to check
     // all of them
     // https://github.com/llvm-mirror/clang-tools-extra/blob/5c40544fa40bfb85ec888b6a03421b3905e4a4e7/clang-tidy/utils/ExprSequence.cpp#L21
-    return llvm::any_of(Result.Context->getParents(Node),
-                        [&, this](const DynTypedNode &Parent) {
-                          return isIgnoredFunctionArgImpl(Result, Parent, Node,
-                                                          Literal);
-                        });
+    for (const DynTypedNode &Parent : Ctx.getParents(Node))
+      findIgnoredFunctionArgs(Ctx, Parent, Node, Counts, Matches);
+    return;
   }
   const auto *FuncRef =
       dyn_cast<DeclRefExpr>(AsCallExpr->getCallee()->IgnoreImpCasts());
   if (!FuncRef) { // not sure if this can happen, better check to be safe
-    return false;
+    return;
   }
 
   IgnoredFunctionArg ArgInfo{
@@ -412,13 +605,22 @@ bool MagicNumbersCheck::isIgnoredFunctionArgImpl(
       it->FunctionName != ArgInfo.FunctionName ||
       it->Position != ArgInfo.Position) {
     // (FunctionName, Position) is not in the list.
-    return false;
+    return;
   }
+  Matches.push_back(&*it);
+}
+
+bool MagicNumbersCheck::isIgnoredFunctionArg(
+    const SourceManager &SM, const IntegerLiteral &Literal,
+    ArrayRef<const IgnoredFunctionArg *> Matches) {
+  if (Matches.empty())
+    return false;
 
+  ++Counters.RadixLexes;
   llvm::SmallVector<char> LiteralBuf;
   SourceLocation Loc = Literal.getLocation();
   StringRef LiteralSpelling =
-      Lexer::getSpelling(Loc, LiteralBuf, *Result.SourceManager, getLangOpts());
+      Lexer::getSpelling(Loc, LiteralBuf, SM, getLangOpts());
   auto Base = IgnoredFunctionArg::Base::DEC;
   // Can LiteralSpelling be empty? In this case, it's considered as a decimal literal.
   // Zero is allowed for any base (it's always ignored).
@@ -433,9 +635,157 @@ bool MagicNumbersCheck::isIgnoredFunctionArgImpl(
       Base = IgnoredFunctionArg::Base::OCT;
     }
   }
-  return Base & it->Bases;
+  return llvm::any_of(Matches, [Base](const IgnoredFunctionArg *Match) {
+    return (Base & Match->Bases) != 0;
+  });
+}
+
+template <typename LanguagePolicy, typename L>
+MagicNumbersCheck::LiteralParents
+MagicNumbersCheck::classifyParents(ASTContext &Ctx, const L &Literal,
+                                   HotCounters &Counts) const {
+  LiteralParents Parents;
+  Parents.UsageInfo = getUsageInfo<LanguagePolicy>(Ctx, Literal, Counts);
+  if (Parents.UsageInfo.Category == ConstCategory::TRUE_CONST ||
+      (Parents.UsageInfo.Category == ConstCategory::RUNTIME_CONST &&
+       Parents.UsageInfo.IsUsedInInitializerList)) {
+    Parents.IsExempt = true;
+    return Parents;
+  }
+
+  if constexpr (std::is_same_v<L, IntegerLiteral>) {
+    if (isBitFieldWidth(Ctx, Literal, Counts)) {
+      Parents.IsExempt = true;
+      return Parents;
+    }
+
+    if (!IgnoredFunctionArgs.empty()) {
+      ++Counts.FunctionArgLookups;
+      for (const DynTypedNode &Parent : Ctx.getParents(Literal))
+        findIgnoredFunctionArgs(Ctx, Parent, DynTypedNode::create(Literal),
+                                Counts, Parents.FunctionArgs);
+    }
+  }
+  return Parents;
 }
 
+// Literals are handed to the workers in chunks of this many, in the order
+// they were matched, so that a huge function is shared by several workers.
+constexpr static size_t DeferredChunkSize = 256;
+
+// With fewer deferred literals than this, starting the workers costs more
+// than it saves, and the literals are classified on this thread.
+constexpr static size_t MinParallelLiterals = 4 * DeferredChunkSize;
+
+// The workers classify this many chunks each before the findings are
+// reported, so that the diagnostics cap and the budget stop the work between
+// two rounds, as they stop the serial mode between two literals.
+constexpr static size_t ChunksPerWorkerPerRound = 4;
+
+template <typename LanguagePolicy>
+void MagicNumbersCheck::checkDeferredLiterals() {
+  if (Deferred.empty())
+    return;
+  ASTContext &Ctx = *DeferredContext;
+  const SourceManager &SM = Ctx.getSourceManager();
+  llvm::TimeTraceScope TimeScope("checkDeferredLiterals", [&] {
+    return std::to_string(Deferred.size());
+  });
+  TraversalKindScope RAII(Ctx, TK_AsIs);
+
+  auto Classify = [&](size_t I, HotCounters &Counts) {
+    if (const auto *Int = Deferred[I].dyn_cast<const IntegerLiteral *>())
+      return classifyParents<LanguagePolicy>(Ctx, *Int, Counts);
+    return classifyParents<LanguagePolicy>(
+        Ctx, *Deferred[I].get<const FloatingLiteral *>(), Counts);
+  };
+  // Reported in the order the literals were matched, as in the serial mode.
+  // Their headers are known already, so looking them up again only finds
+  // where to record their findings.
+  auto Report = [&](size_t I, const LiteralParents &Parents) {
+    HeaderFindings *Recording = nullptr;
+    if (const auto *Int = Deferred[I].dyn_cast<const IntegerLiteral *>()) {
+      if (DeduplicateHeaderDiagnostics)
+        lookupHeaderVerdict(SM, Int->getLocation(), Recording);
+      reportLiteral(Ctx, *Int, Parents, Recording);
+    } else {
+      const auto *Float = Deferred[I].get<const FloatingLiteral *>();
+      if (DeduplicateHeaderDiagnostics)
+        lookupHeaderVerdict(SM, Float->getLocation(), Recording);
+      reportLiteral(Ctx, *Float, Parents, Recording);
+    }
+  };
+
+  if (Deferred.size() < MinParallelLiterals) {
+    for (size_t I = 0; I < Deferred.size(); ++I) {
+      if (hasReachedDiagnosticsCap() || isOverBudget(SM, Budget.update()))
+        break;
+      Report(I, Classify(I, Counters));
+    }
+    Deferred.clear();
+    DeferredContext = nullptr;
+    return;
+  }
+
+  // The workers only read the ASTContext: its lazily built parent map and its
+  // traversal kind are set up here, before they start. Building the map may
+  // take long enough to exhaust the budget.
+  Ctx.getParents(*Ctx.getTranslationUnitDecl());
+  if (isOverBudget(SM, Budget.updateNow())) {
+    Deferred.clear();
+    DeferredContext = nullptr;
+    return;
+  }
+
+  // The workers are not covered by the perf counters, which only sample the
+  // calling thread; their hot-path counters are summed into those of the
+  // check.
+  llvm::ThreadPool Pool(llvm::hardware_concurrency(ParallelJobs));
+  std::vector<HotCounters> WorkerCounts(Pool.getThreadCount());
+  const size_t RoundSize =
+      WorkerCounts.size() * ChunksPerWorkerPerRound * DeferredChunkSize;
+  std::vector<LiteralParents> Results;
+  for (size_t Begin = 0; Begin < Deferred.size(); Begin += RoundSize) {
+    const size_t End = std::min(Deferred.size(), Begin + RoundSize);
+    Results.assign(End - Begin, LiteralParents());
+    const size_t NumChunks = llvm::divideCeil(End - Begin, DeferredChunkSize);
+    std::atomic<size_t> NextChunk(0);
+    for (size_t Worker = 0; Worker < WorkerCounts.size(); ++Worker)
+      Pool.async([&, Worker] {
+        HotCounters &Counts = WorkerCounts[Worker];
+        for (size_t Chunk = NextChunk++; Chunk < NumChunks;
+             Chunk = NextChunk++) {
+          const size_t ChunkBegin = Begin + Chunk * DeferredChunkSize;
+          const size_t ChunkEnd =
+              std::min(End, ChunkBegin + DeferredChunkSize);
+          for (size_t I = ChunkBegin; I < ChunkEnd; ++I)
+            Results[I - Begin] = Classify(I, Counts);
+        }
+      });
+    Pool.wait();
+
+    for (size_t I = Begin; I < End && !hasReachedDiagnosticsCap(); ++I)
+      Report(I, Results[I - Begin]);
+    if (hasReachedDiagnosticsCap() || isOverBudget(SM, Budget.updateNow()))
+      break;
+  }
+  for (const HotCounters &Counts : WorkerCounts)
+    Counters += Counts;
+  Deferred.clear();
+  DeferredContext = nullptr;
+}
+
+template void MagicNumbersCheck::onLiteral<CLanguagePolicy>(
+    ASTContext &Ctx, const IntegerLiteral &Literal);
+template void MagicNumbersCheck::onLiteral<CLanguagePolicy>(
+    ASTContext &Ctx, const FloatingLiteral &Literal);
+template void MagicNumbersCheck::onLiteral<AnyLanguagePolicy>(
+    ASTContext &Ctx, const IntegerLiteral &Literal);
+template void MagicNumbersCheck::onLiteral<AnyLanguagePolicy>(
+    ASTContext &Ctx, const FloatingLiteral &Literal);
+template void MagicNumbersCheck::checkDeferredLiterals<CLanguagePolicy>();
+template void MagicNumbersCheck::checkDeferredLiterals<AnyLanguagePolicy>();
+
 } // namespace caos
 } // namespace tidy
 } // namespace clang
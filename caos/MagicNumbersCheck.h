@@ -12,9 +12,22 @@
 #include <type_traits>
 
 #include "../clang-tidy/ClangTidyCheck.h"
+#include "CheckPerfCounters.h"
+#include "CheckStatistics.h"
+#include "HeaderVerdictStore.h"
+#include "LanguagePolicy.h"
+#include "LineFilterIndex.h"
+#include "NoLintIndex.h"
+#include "TranslationUnitBudget.h"
+#include "TranslationUnitTrace.h"
 #include "clang/Lex/Lexer.h"
 #include <llvm/ADT/APFloat.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/PointerUnion.h>
 #include <llvm/ADT/SmallVector.h>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace clang {
 namespace tidy {
@@ -24,12 +37,14 @@ namespace caos {
 ///
 /// For the user-facing documentation see:
 /// http://clang.llvm.org/extra/clang-tidy/checks/readability/magic-numbers.html
+///
+/// The literals are checked by \c MagicNumbersCheckFor, the instantiation for
+/// the language of the translation unit.
 class MagicNumbersCheck : public ClangTidyCheck {
 public:
-  MagicNumbersCheck(StringRef Name, ClangTidyContext *Context);
   void storeOptions(ClangTidyOptions::OptionMap &Opts) override;
   void registerMatchers(ast_matchers::MatchFinder *Finder) override;
-  void check(const ast_matchers::MatchFinder::MatchResult &Result) override;
+  void onEndOfTranslationUnit() override;
 
   enum class ConstCategory {
     NONE,
@@ -42,16 +57,62 @@ public:
     bool IsUsedInInitializerList = false;
   };
 
+  enum class FindingKind {
+    MAGIC_NUMBER,
+    RUNTIME_CONST_INTEGER,
+    RUNTIME_CONST_FLOAT,
+  };
+
+  /// A reported literal, in the form stored for header deduplication.
+  struct Finding {
+    unsigned Offset;
+    FindingKind Kind;
+    std::string LiteralText;
+  };
+
+  using HeaderFindings = std::vector<Finding>;
+
+protected:
+  MagicNumbersCheck(StringRef Name, ClangTidyContext *Context);
+
+  /// Checks \p Literal, leaving out the constructs of the languages
+  /// \p LanguagePolicy excludes. Instantiated for the policies of
+  /// LanguagePolicy.h.
+  template <typename LanguagePolicy, typename L>
+  void onLiteral(ASTContext &Ctx, const L &Literal);
+
+  /// Classifies the literals deferred by the parallel mode on a thread pool,
+  /// or on this thread if there are few of them, and reports them.
+  /// Instantiated like \c onLiteral.
+  template <typename LanguagePolicy> void checkDeferredLiterals();
+
 private:
+  friend class MagicNumbersCheckBenchmark;
+
   // For static_assert in constexpr if. See
   // https://en.cppreference.com/w/cpp/language/if#Constexpr_If
   template <class> inline static constexpr bool dependent_false_v = false;
 
+  /// Parses the ignored values and function arguments, on the first literal.
+  void parseOptionLists();
   void parseIgnoredFunctionArgs();
 
-  LiteralUsageInfo
-  getUsageInfo(const clang::ast_matchers::MatchFinder::MatchResult &Result,
-               const clang::Expr &ExprResult) const;
+  void reportFinding(const SourceManager &SM, SourceLocation Loc,
+                     FindingKind Kind, StringRef LiteralText,
+                     HeaderFindings *Recording);
+
+  bool lookupHeaderVerdict(const SourceManager &SM, SourceLocation Loc,
+                           HeaderFindings *&Recording);
+
+  void measureParentMap(ASTContext &Ctx, const Expr &Literal);
+
+  bool hasReachedDiagnosticsCap() const {
+    return MaxDiagnosticsPerFile != 0 &&
+           ReportedDiagnostics >= MaxDiagnosticsPerFile;
+  }
+
+  bool isOverBudget(const SourceManager &SM,
+                    TranslationUnitBudget::State State);
 
   bool isIgnoredValue(const IntegerLiteral *Literal) const;
   bool isIgnoredValue(const FloatingLiteral *Literal) const;
@@ -59,109 +120,215 @@ private:
   bool isSyntheticValue(const clang::SourceManager *SourceManager,
                         const IntegerLiteral *Literal) const;
 
-  bool
-  isBitFieldWidth(const clang::ast_matchers::MatchFinder::MatchResult &Result,
-                  const IntegerLiteral &Literal) const;
+  struct IgnoredFunctionArg {
+    enum Base {
+      DEC = 1,
+      OCT = 2,
+      HEX = 4,
+      BIN = 8,
+      ANY = DEC | OCT | HEX | BIN,
+    };
+
+    StringRef FunctionName;
+    // Single integer is used instead of an array, because in most cases
+    // literals are allowed only in 1 arg of a function.
+    // Also, different arguments can have different allowed bases.
+    unsigned Position;
+    Base Bases;
+
+    bool operator<(const IgnoredFunctionArg &other) const {
+      return FunctionName < other.FunctionName ||
+             (FunctionName == other.FunctionName && Position < other.Position);
+    }
+  };
+
+  /// Hot-path counters. The workers of the parallel mode count in their own.
+  struct HotCounters {
+    uint64_t LiteralsMatched = 0;
+    uint64_t LiteralsSuppressed = 0;
+    uint64_t LiteralsFiltered = 0;
+    uint64_t ParentNodesVisited = 0;
+    uint64_t FunctionArgLookups = 0;
+    uint64_t RadixLexes = 0;
+
+    HotCounters &operator+=(const HotCounters &Other) {
+      LiteralsMatched += Other.LiteralsMatched;
+      LiteralsSuppressed += Other.LiteralsSuppressed;
+      LiteralsFiltered += Other.LiteralsFiltered;
+      ParentNodesVisited += Other.ParentNodesVisited;
+      FunctionArgLookups += Other.FunctionArgLookups;
+      RadixLexes += Other.RadixLexes;
+      return *this;
+    }
+  };
+
+  /// What the ancestors of a literal make of it. Found from the AST alone,
+  /// which the parallel mode lets several threads read at once.
+  struct LiteralParents {
+    LiteralUsageInfo UsageInfo;
+    /// Set if the ancestors exempt the literal whatever its spelling.
+    bool IsExempt = false;
+    /// The ignored function arguments the literal is passed as. Whether its
+    /// base is allowed depends on its spelling.
+    llvm::SmallVector<const IgnoredFunctionArg *, 1> FunctionArgs;
+  };
+
+  template <typename LanguagePolicy>
+  LiteralUsageInfo getUsageInfo(ASTContext &Ctx, const clang::Expr &ExprResult,
+                                HotCounters &Counts) const;
+
+  bool isBitFieldWidth(ASTContext &Ctx, const IntegerLiteral &Literal,
+                       HotCounters &Counts) const;
 
-  bool isIgnoredFunctionArg(
-      const clang::ast_matchers::MatchFinder::MatchResult &Result,
-      const IntegerLiteral &Literal) const;
+  void findIgnoredFunctionArgs(
+      ASTContext &Ctx, const DynTypedNode &Node, const DynTypedNode &Child,
+      HotCounters &Counts,
+      llvm::SmallVectorImpl<const IgnoredFunctionArg *> &Matches) const;
 
-  bool isIgnoredFunctionArgImpl(
-      const ast_matchers::MatchFinder::MatchFinder::MatchResult &Result,
-      const DynTypedNode &Node, const DynTypedNode &Child,
-      const IntegerLiteral &Literal) const;
+  bool isIgnoredFunctionArg(const SourceManager &SM,
+                            const IntegerLiteral &Literal,
+                            ArrayRef<const IgnoredFunctionArg *> Matches);
 
+  /// Walks the ancestors of \p Literal. Thread-safe once the parent map of
+  /// \p Ctx is built and its traversal kind set.
+  template <typename LanguagePolicy, typename L>
+  LiteralParents classifyParents(ASTContext &Ctx, const L &Literal,
+                                 HotCounters &Counts) const;
+
+  /// The checks of \p Literal that use the SourceManager, which isn't
+  /// thread-safe. Returns false if they exempt it.
   template <typename L>
-  void checkBoundMatch(const ast_matchers::MatchFinder::MatchResult &Result,
-                       const char *BoundName) {
-    const L *MatchedLiteral = Result.Nodes.getNodeAs<L>(BoundName);
-    if (!MatchedLiteral)
-      return;
+  bool isCandidate(const SourceManager &SM, const L &Literal,
+                   HeaderFindings *&Recording) {
+    ++Counters.LiteralsMatched;
+
+    if (SM.isMacroBodyExpansion(Literal.getLocation()))
+      return false;
 
-    if (Result.SourceManager->isMacroBodyExpansion(
-            MatchedLiteral->getLocation()))
+    if (LineFilter.isFiltered(SM, Literal.getLocation())) {
+      ++Counters.LiteralsFiltered;
+      return false;
+    }
+
+    if (NoLints.isSuppressed(SM, Literal.getLocation())) {
+      ++Counters.LiteralsSuppressed;
+      return false;
+    }
+
+    if (DeduplicateHeaderDiagnostics &&
+        !lookupHeaderVerdict(SM, Literal.getLocation(), Recording))
+      return false;
+
+    if (isIgnoredValue(&Literal))
+      return false;
+
+    if constexpr (std::is_same_v<L, IntegerLiteral>) {
+      if (isSyntheticValue(&SM, &Literal))
+        return false;
+    }
+    return true;
+  }
+
+  template <typename LanguagePolicy, typename L>
+  void checkLiteral(ASTContext &Ctx, const L &Literal) {
+    const SourceManager &SM = Ctx.getSourceManager();
+    HeaderFindings *Recording = nullptr;
+    if (!isCandidate(SM, Literal, Recording))
       return;
 
-    if (isIgnoredValue(MatchedLiteral))
+    if (ParallelJobs != 0) {
+      DeferredContext = &Ctx;
+      Deferred.push_back(&Literal);
       return;
+    }
+    reportLiteral(Ctx, Literal,
+                  classifyParents<LanguagePolicy>(Ctx, Literal, Counters),
+                  Recording);
+  }
 
-    LiteralUsageInfo UsageInfo = getUsageInfo(Result, *MatchedLiteral);
-    if (UsageInfo.Category == ConstCategory::TRUE_CONST ||
-        (UsageInfo.Category == ConstCategory::RUNTIME_CONST &&
-         UsageInfo.IsUsedInInitializerList))
+  template <typename L>
+  void reportLiteral(ASTContext &Ctx, const L &Literal,
+                     const LiteralParents &Parents,
+                     HeaderFindings *Recording) {
+    if (Parents.IsExempt)
       return;
 
+    const SourceManager &SM = Ctx.getSourceManager();
     if constexpr (std::is_same_v<L, IntegerLiteral>) {
-      if (isSyntheticValue(Result.SourceManager, MatchedLiteral))
-        return;
-
-      if (isBitFieldWidth(Result, *MatchedLiteral))
-        return;
-
-      if (isIgnoredFunctionArg(Result, *MatchedLiteral))
+      if (isIgnoredFunctionArg(SM, Literal, Parents.FunctionArgs))
         return;
     }
 
     const StringRef LiteralSourceText = Lexer::getSourceText(
-        CharSourceRange::getTokenRange(MatchedLiteral->getSourceRange()),
-        *Result.SourceManager, getLangOpts());
+        CharSourceRange::getTokenRange(Literal.getSourceRange()),
+        SM, getLangOpts());
 
-    if (UsageInfo.Category == ConstCategory::RUNTIME_CONST) {
+    FindingKind Kind = FindingKind::MAGIC_NUMBER;
+    if (Parents.UsageInfo.Category == ConstCategory::RUNTIME_CONST) {
       if constexpr (std::is_same_v<L, IntegerLiteral>) {
-        diag(MatchedLiteral->getLocation(),
-             "'const' in C is not a compile-time constant; consider using an "
-             "enum for integer constants");
+        Kind = FindingKind::RUNTIME_CONST_INTEGER;
       } else if constexpr (std::is_same_v<L, FloatingLiteral>) {
-        diag(MatchedLiteral->getLocation(),
-             "'const' in C is not a compile-time constant; consider using a "
-             "#define for floating-point constants");
+        Kind = FindingKind::RUNTIME_CONST_FLOAT;
       } else {
         static_assert(dependent_false_v<L>, "Not implemented");
       }
-    } else {
-      diag(MatchedLiteral->getLocation(),
-           "%0 is a magic number; consider replacing it with a named constant")
-          << LiteralSourceText;
     }
+    reportFinding(SM, Literal.getLocation(), Kind, LiteralSourceText,
+                  Recording);
   }
 
-  struct IgnoredFunctionArg {
-    enum Base {
-      DEC = 1,
-      OCT = 2,
-      HEX = 4,
-      BIN = 8,
-      ANY = DEC | OCT | HEX | BIN,
-    };
-
-    StringRef FunctionName;
-    // Single integer is used instead of an array, because in most cases
-    // literals are allowed only in 1 arg of a function.
-    // Also, different arguments can have different allowed bases.
-    unsigned Position;
-    Base Bases;
-
-    bool operator<(const IgnoredFunctionArg &other) const {
-      return FunctionName < other.FunctionName ||
-             (FunctionName == other.FunctionName && Position < other.Position);
-    }
-  };
-
+  // Declared first, so that its construction event covers the other members.
+  const TranslationUnitTrace Trace;
+  // Literals in system headers are skipped unless clang-tidy reports
+  // diagnostics there.
+  const bool CheckSystemHeaders;
   const bool IgnoreAllFloatingPointValues;
   const bool IgnoreBitFieldsWidths;
   const bool IgnorePowersOf2IntegerValues;
   // Legacy option. Use IgnoredFunctionArgs instead
   const bool IgnoreStrtolBases;
+  const bool DeduplicateHeaderDiagnostics;
   const StringRef RawIgnoredIntegerValues;
   const StringRef RawIgnoredFloatingPointValues;
   const StringRef RawIgnoredFunctionArgs;
+  const unsigned TimeBudgetMs;
+  const unsigned MemoryBudgetMiB;
+  // Once this many literals have been reported, the rest of the translation
+  // unit is skipped. 0 means no limit.
+  const unsigned MaxDiagnosticsPerFile;
+  // Worker threads classifying the literals of a translation unit at its
+  // end. 0 means the literals are checked one by one as they are matched.
+  const unsigned ParallelJobs;
+  TranslationUnitBudget Budget;
+  unsigned ReportedDiagnostics = 0;
+
+  /// Hot-path counters for the current translation unit.
+  HotCounters Counters;
+  const StatisticsOptions Statistics;
+  const CheckPerfCounters Perf;
+  const std::string MainFile;
+  /// Where NOLINT comments suppress this check, so that suppressed literals
+  /// are not analysed.
+  NoLintIndex NoLints;
+  /// The lines clang-tidy keeps diagnostics on, so that literals on the
+  /// others are not analysed.
+  LineFilterIndex LineFilter;
+
+  /// Memory accounting for the current translation unit, if enabled.
+  struct {
+    uint64_t InitialPeakResidentBytes = 0;
+    /// Heap growth caused by building the parent map of the AST; unset until
+    /// the first literal is checked.
+    std::optional<uint64_t> ParentMapBytes;
+  } Memory;
 
   constexpr static unsigned SensibleNumberOfMagicValueExceptions = 16;
 
   constexpr static llvm::APFloat::roundingMode DefaultRoundingMode =
       llvm::APFloat::rmNearestTiesToEven;
 
+  // The parsed option lists, empty until OptionListsParsed.
+  bool OptionListsParsed = false;
   llvm::SmallVector<int64_t, SensibleNumberOfMagicValueExceptions>
       IgnoredIntegerValues;
   llvm::SmallVector<float, SensibleNumberOfMagicValueExceptions>
@@ -170,6 +337,46 @@ private:
       IgnoredDoublePointValues;
   llvm::SmallVector<IgnoredFunctionArg, SensibleNumberOfMagicValueExceptions>
       IgnoredFunctionArgs;
+
+  struct HeaderState {
+    HeaderVerdictKey Key;
+    // True if the findings were replayed from the store, so literals in this
+    // header are not analysed again.
+    bool IsReplayed = false;
+    HeaderFindings Findings;
+  };
+
+  /// The fingerprints of the options and of the translation unit, combined
+  /// for the first header whose findings are looked up.
+  std::optional<uint64_t> ContextFingerprint;
+  llvm::DenseMap<FileID, HeaderState> Headers;
+
+  /// The candidate literals of the parallel mode, in the order they were
+  /// matched.
+  std::vector<llvm::PointerUnion<const IntegerLiteral *,
+                                 const FloatingLiteral *>>
+      Deferred;
+  ASTContext *DeferredContext = nullptr;
+};
+
+/// \c MagicNumbersCheck for the translation units \p LanguagePolicy allows.
+template <typename LanguagePolicy>
+class MagicNumbersCheckFor final : public MagicNumbersCheck {
+public:
+  MagicNumbersCheckFor(StringRef Name, ClangTidyContext *Context)
+      : MagicNumbersCheck(Name, Context) {}
+
+  void check(const ast_matchers::MatchFinder::MatchResult &Result) override {
+    if (const auto *Literal = Result.Nodes.getNodeAs<IntegerLiteral>("integer"))
+      onLiteral<LanguagePolicy>(*Result.Context, *Literal);
+    else if (const auto *Literal =
+                 Result.Nodes.getNodeAs<FloatingLiteral>("float"))
+      onLiteral<LanguagePolicy>(*Result.Context, *Literal);
+  }
+  void onEndOfTranslationUnit() override {
+    checkDeferredLiterals<LanguagePolicy>();
+    MagicNumbersCheck::onEndOfTranslationUnit();
+  }
 };
 
 } // namespace caos
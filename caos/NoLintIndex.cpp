@@ -0,0 +1,177 @@
+//===--- NoLintIndex.cpp - clang-tidy -------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "NoLintIndex.h"
+#include "../clang-tidy/GlobList.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSwitch.h"
+#include <algorithm>
+#include <optional>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+namespace {
+
+enum class NoLintType { NoLint, NoLintNextLine, NoLintBegin, NoLintEnd };
+
+struct NoLintToken {
+  NoLintType Type;
+  size_t Pos;
+  /// The checks between the parentheses, without whitespace; unset if there
+  /// are none, which stands for all checks.
+  std::optional<std::string> Checks;
+};
+
+} // namespace
+
+// Tokenizes the directives of Buffer as clang-tidy's NoLintDirectiveHandler
+// does: anywhere in the text, not only in comments, with the checks in
+// parentheses right after the directive and on the same line.
+static llvm::SmallVector<NoLintToken> getNoLints(StringRef Buffer) {
+  static constexpr llvm::StringLiteral NoLint = "NOLINT";
+  llvm::SmallVector<NoLintToken> NoLints;
+
+  size_t Pos = 0;
+  while (Pos < Buffer.size()) {
+    const size_t NoLintPos = Buffer.find(NoLint, Pos);
+    if (NoLintPos == StringRef::npos)
+      break;
+
+    Pos = NoLintPos + NoLint.size();
+    while (Pos < Buffer.size() && llvm::isAlpha(Buffer[Pos]))
+      ++Pos;
+    const std::optional<NoLintType> Type =
+        llvm::StringSwitch<std::optional<NoLintType>>(
+            Buffer.slice(NoLintPos, Pos))
+            .Case("NOLINT", NoLintType::NoLint)
+            .Case("NOLINTNEXTLINE", NoLintType::NoLintNextLine)
+            .Case("NOLINTBEGIN", NoLintType::NoLintBegin)
+            .Case("NOLINTEND", NoLintType::NoLintEnd)
+            .Default(std::nullopt);
+    if (!Type)
+      continue;
+
+    std::optional<std::string> Checks;
+    if (Pos < Buffer.size() && Buffer[Pos] == '(') {
+      const size_t ClosingBracket = Buffer.find_first_of("\n)", Pos + 1);
+      if (ClosingBracket != StringRef::npos && Buffer[ClosingBracket] == ')') {
+        Checks = Buffer.slice(Pos + 1, ClosingBracket).str();
+        llvm::erase_if(*Checks, llvm::isSpace);
+        Pos = ClosingBracket + 1;
+      }
+    }
+    NoLints.push_back({*Type, NoLintPos, std::move(Checks)});
+  }
+  return NoLints;
+}
+
+// The offsets of the line Pos is on, without its line break.
+static std::pair<size_t, size_t> getLine(StringRef Buffer, size_t Pos) {
+  // npos + 1 wraps around to the start of the buffer.
+  const size_t Start = Buffer.rfind('\n', Pos) + 1;
+  const size_t End = std::min(Buffer.find('\n', Pos), Buffer.size());
+  return {Start, End};
+}
+
+std::vector<NoLintIndex::Interval>
+NoLintIndex::scan(StringRef Buffer) const {
+  std::vector<Interval> Intervals;
+  const llvm::SmallVector<NoLintToken> NoLints = getNoLints(Buffer);
+  if (NoLints.empty())
+    return Intervals;
+
+  auto Suppresses = [this](const NoLintToken &NoLint) {
+    return GlobList(NoLint.Checks.value_or("*"), /*KeepNegativeGlobs=*/false)
+        .contains(CheckName);
+  };
+  auto Add = [&Intervals](size_t Begin, size_t End) {
+    if (Begin < End)
+      Intervals.emplace_back(Begin, End);
+  };
+
+  // Blocks pair each NOLINTEND with the innermost open NOLINTBEGIN, which
+  // must name the same checks.
+  llvm::SmallVector<const NoLintToken *> Open;
+  llvm::SmallVector<std::pair<const NoLintToken *, const NoLintToken *>>
+      Blocks;
+  bool HasUnmatched = false;
+  for (const NoLintToken &NoLint : NoLints) {
+    switch (NoLint.Type) {
+    case NoLintType::NoLint:
+      if (Suppresses(NoLint)) {
+        const auto [Start, End] = getLine(Buffer, NoLint.Pos);
+        Add(Start, End);
+      }
+      break;
+    case NoLintType::NoLintNextLine:
+      if (Suppresses(NoLint)) {
+        const size_t LineBreak = Buffer.find('\n', NoLint.Pos);
+        if (LineBreak != StringRef::npos) {
+          const auto [Start, End] = getLine(Buffer, LineBreak + 1);
+          Add(Start, End);
+        }
+      }
+      break;
+    case NoLintType::NoLintBegin:
+      Open.push_back(&NoLint);
+      break;
+    case NoLintType::NoLintEnd:
+      if (!Open.empty() && Open.back()->Checks == NoLint.Checks)
+        Blocks.emplace_back(Open.pop_back_val(), &NoLint);
+      else
+        HasUnmatched = true;
+      break;
+    }
+  }
+  if (!HasUnmatched && Open.empty())
+    for (const auto &[Begin, End] : Blocks)
+      if (Suppresses(*Begin))
+        Add(Begin->Pos + 1, End->Pos);
+
+  // Merge into disjoint intervals, so that a lookup needs a single one.
+  llvm::sort(Intervals);
+  std::vector<Interval> Merged;
+  for (const Interval &I : Intervals) {
+    if (!Merged.empty() && I.first <= Merged.back().second)
+      Merged.back().second = std::max(Merged.back().second, I.second);
+    else
+      Merged.push_back(I);
+  }
+  return Merged;
+}
+
+bool NoLintIndex::isSuppressed(const SourceManager &SM, SourceLocation Loc) {
+  if (!Loc.isFileID())
+    return false;
+  const auto [FID, Offset] = SM.getDecomposedLoc(Loc);
+  if (FID.isInvalid())
+    return false;
+
+  auto It = Files.find(FID);
+  if (It == Files.end()) {
+    bool Invalid = false;
+    const StringRef Buffer = SM.getBufferData(FID, &Invalid);
+    It = Files.try_emplace(FID, Invalid ? std::vector<Interval>()
+                                        : scan(Buffer))
+             .first;
+  }
+
+  const std::vector<Interval> &Intervals = It->second;
+  auto After = llvm::upper_bound(
+      Intervals, Offset,
+      [](unsigned Pos, const Interval &I) { return Pos < I.first; });
+  return After != Intervals.begin() && Offset < std::prev(After)->second;
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
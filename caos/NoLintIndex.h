@@ -0,0 +1,59 @@
+//===--- NoLintIndex.h - clang-tidy -----------------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_NOLINTINDEX_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_NOLINTINDEX_H
+
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/DenseMap.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+/// The regions of the files of a translation unit in which clang-tidy
+/// suppresses the diagnostics of one check.
+///
+/// clang-tidy only applies NOLINT, NOLINTNEXTLINE and NOLINTBEGIN/NOLINTEND
+/// once a diagnostic has been built, so a check pays for the analysis of a
+/// finding nobody will see. Checks look their findings up here first instead:
+/// on the first lookup in a file, its directives are parsed the way
+/// clang-tidy parses them into a sorted set of offset intervals, and each
+/// lookup is then a binary search.
+///
+/// The index errs on the side of checking: locations in macro expansions are
+/// never reported as suppressed, nor are NOLINTBEGIN/NOLINTEND blocks of a
+/// file with unmatched ones, which clang-tidy reports as errors.
+class NoLintIndex {
+public:
+  explicit NoLintIndex(StringRef CheckName) : CheckName(CheckName) {}
+
+  /// Whether clang-tidy will suppress a diagnostic of the check at \p Loc.
+  bool isSuppressed(const SourceManager &SM, SourceLocation Loc);
+
+  /// Forgets the files of the current translation unit.
+  void clear() { Files.clear(); }
+
+private:
+  /// Half-open interval of file offsets.
+  using Interval = std::pair<unsigned, unsigned>;
+
+  std::vector<Interval> scan(StringRef Buffer) const;
+
+  const std::string CheckName;
+  llvm::DenseMap<FileID, std::vector<Interval>> Files;
+};
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_NOLINTINDEX_H
@@ -0,0 +1,92 @@
+//===--- TranslationUnitBudget.cpp - clang-tidy ---------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "TranslationUnitBudget.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/Process.h"
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+const char BudgetExceededMessage[] =
+    "analysis stopped after exceeding the %0; findings for this translation "
+    "unit are incomplete";
+const char BudgetExceededNote[] = "in the translation unit of this file";
+
+// Returns the resident set size of the process in bytes, or the malloc usage
+// where /proc is not available.
+static uint64_t getResidentBytes() {
+  llvm::Expected<llvm::sys::fs::file_t> FD =
+      llvm::sys::fs::openNativeFileForRead("/proc/self/statm");
+  if (!FD) {
+    llvm::consumeError(FD.takeError());
+    return llvm::sys::Process::GetMallocUsage();
+  }
+  char Buffer[128];
+  llvm::Expected<size_t> Read =
+      llvm::sys::fs::readNativeFile(*FD, llvm::MutableArrayRef(Buffer));
+  llvm::sys::fs::closeFile(*FD);
+  if (!Read) {
+    llvm::consumeError(Read.takeError());
+    return llvm::sys::Process::GetMallocUsage();
+  }
+
+  // "size resident shared ...", in pages.
+  uint64_t ResidentPages;
+  StringRef Fields(Buffer, *Read);
+  if (Fields.split(' ').second.split(' ').first.getAsInteger(10,
+                                                             ResidentPages))
+    return llvm::sys::Process::GetMallocUsage();
+  return ResidentPages * llvm::sys::Process::getPageSizeEstimate();
+}
+
+TranslationUnitBudget::TranslationUnitBudget(unsigned TimeLimitMs,
+                                             unsigned MemoryLimitMiB)
+    : Start(std::chrono::steady_clock::now()), TimeLimitMs(TimeLimitMs),
+      MemoryLimitMiB(MemoryLimitMiB),
+      StartResidentBytes(MemoryLimitMiB != 0 ? getResidentBytes() : 0),
+      IsLimited(TimeLimitMs != 0 || MemoryLimitMiB != 0) {}
+
+TranslationUnitBudget::State TranslationUnitBudget::poll() {
+  if (TimeLimitMs != 0) {
+    SpentMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - Start)
+                  .count();
+    if (SpentMs > TimeLimitMs)
+      CurrentState = State::JustExceeded;
+  }
+  if (MemoryLimitMiB != 0 && CurrentState == State::Within) {
+    const uint64_t ResidentBytes = getResidentBytes();
+    GrownMiB = ResidentBytes > StartResidentBytes
+                   ? (ResidentBytes - StartResidentBytes) >> 20
+                   : 0;
+    if (GrownMiB > MemoryLimitMiB)
+      CurrentState = State::JustExceeded;
+  }
+
+  if (CurrentState == State::Within)
+    return State::Within;
+  // Only the caller that detected the overrun gets JustExceeded.
+  CurrentState = State::Exceeded;
+  return State::JustExceeded;
+}
+
+std::string TranslationUnitBudget::describe() const {
+  if (TimeLimitMs != 0 && SpentMs > TimeLimitMs)
+    return llvm::formatv("time budget of {0} ms (spent {1} ms)", TimeLimitMs,
+                         SpentMs);
+  return llvm::formatv("memory budget of {0} MiB (grew by {1} MiB)",
+                       MemoryLimitMiB, GrownMiB);
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
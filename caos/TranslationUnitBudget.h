@@ -0,0 +1,100 @@
+//===--- TranslationUnitBudget.h - clang-tidy -------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_TRANSLATIONUNITBUDGET_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_TRANSLATIONUNITBUDGET_H
+
+#include "clang/Basic/LLVM.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+/// Wall-clock and resident memory budget of a check for one translation unit,
+/// measured from the construction of the check: the memory is the growth of
+/// the resident set since then, as a process that analyses several
+/// translation units doesn't give memory back between them.
+///
+/// Polling is amortised: the clock and the resident set size are read only
+/// every \c PollInterval calls to \c update(), so checks can call it on every
+/// match without a system call each time.
+class TranslationUnitBudget {
+public:
+  enum class State {
+    Within,
+    /// Returned by the call that detected the overrun, so that the caller can
+    /// report it exactly once.
+    JustExceeded,
+    Exceeded,
+  };
+
+  /// A limit of 0 means unlimited.
+  TranslationUnitBudget(unsigned TimeLimitMs, unsigned MemoryLimitMiB);
+
+  State update() {
+    if (CurrentState != State::Within)
+      return State::Exceeded;
+    if (!IsLimited || ++Calls < PollInterval)
+      return State::Within;
+    Calls = 0;
+    return poll();
+  }
+
+  /// Like \c update(), but reads the clock and the resident set size now,
+  /// e.g. before a long step.
+  State updateNow() {
+    if (CurrentState != State::Within)
+      return State::Exceeded;
+    if (!IsLimited)
+      return State::Within;
+    Calls = 0;
+    return poll();
+  }
+
+  bool isExceeded() const { return CurrentState != State::Within; }
+
+  /// Describes the exceeded limit, e.g. "time budget of 5000 ms (spent 5003
+  /// ms)" or "memory budget of 512 MiB (grew by 530 MiB)".
+  std::string describe() const;
+
+  static constexpr unsigned PollInterval = 256;
+
+private:
+  State poll();
+
+  const std::chrono::steady_clock::time_point Start;
+  const unsigned TimeLimitMs;
+  const unsigned MemoryLimitMiB;
+  /// The resident set size at \c Start, if there is a memory limit.
+  const uint64_t StartResidentBytes;
+  const bool IsLimited;
+  unsigned Calls = 0;
+  State CurrentState = State::Within;
+  // Usage observed when the budget was exceeded.
+  uint64_t SpentMs = 0;
+  uint64_t GrownMiB = 0;
+};
+
+/// Message of the diagnostic reported when a budget is exceeded; %0 is
+/// \c TranslationUnitBudget::describe().
+///
+/// The diagnostic has no location, so that neither the line filter nor a
+/// NOLINT comment hides that the findings are incomplete. It is followed by a
+/// note with \c BudgetExceededNote at the start of the main file, which
+/// tells the translation units apart.
+extern const char BudgetExceededMessage[];
+extern const char BudgetExceededNote[];
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_TRANSLATIONUNITBUDGET_H
@@ -0,0 +1,79 @@
+//===--- TranslationUnitTrace.cpp - clang-tidy ----------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "TranslationUnitTrace.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+// The checks of a translation unit run on one thread, as does the profiler.
+static thread_local unsigned SessionMembers = 0;
+
+static std::string getDefaultTraceDirectory() {
+  return llvm::sys::Process::GetEnv("CAOS_TIME_TRACE_DIR").value_or("");
+}
+
+TranslationUnitTrace::TranslationUnitTrace(
+    const ClangTidyCheck::OptionsView &Options, StringRef CheckName,
+    StringRef MainFile)
+    : Directory(Options.getLocalOrGlobal("TimeTraceDirectory",
+                                         getDefaultTraceDirectory())),
+      GranularityUs(Options.getLocalOrGlobal("TimeTraceGranularityUs", 500U)),
+      MainFile(MainFile) {
+  // Don't take over a profiler started by someone else.
+  if (!Directory.empty() &&
+      (SessionMembers != 0 || !llvm::timeTraceProfilerEnabled())) {
+    if (SessionMembers++ == 0)
+      llvm::timeTraceProfilerInitialize(GranularityUs, "clang-tidy");
+    IsSessionMember = true;
+  }
+  llvm::timeTraceProfilerBegin("CheckConstruction", CheckName);
+}
+
+void TranslationUnitTrace::endConstruction() const {
+  llvm::timeTraceProfilerEnd();
+}
+
+TranslationUnitTrace::~TranslationUnitTrace() {
+  if (!IsSessionMember || --SessionMembers != 0)
+    return;
+
+  // Sources with the same name in different directories get different traces.
+  std::string FileName =
+      llvm::formatv("{0}-{1:x-16}.json", llvm::sys::path::filename(MainFile),
+                    llvm::xxHash64(MainFile));
+  SmallString<256> Path(Directory);
+  llvm::sys::path::append(Path, FileName);
+  if (std::error_code EC = llvm::sys::fs::create_directories(Directory)) {
+    llvm::errs() << "caos: cannot create " << Directory << ": "
+                 << EC.message() << "\n";
+  } else if (llvm::Error Err = llvm::timeTraceProfilerWrite(Path, "")) {
+    llvm::errs() << "caos: cannot write time trace: "
+                 << llvm::toString(std::move(Err)) << "\n";
+  }
+  llvm::timeTraceProfilerCleanup();
+}
+
+void TranslationUnitTrace::store(const ClangTidyCheck::OptionsView &Options,
+                                 ClangTidyOptions::OptionMap &Opts) const {
+  Options.store(Opts, "TimeTraceDirectory", Directory);
+  Options.store(Opts, "TimeTraceGranularityUs", GranularityUs);
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
@@ -0,0 +1,57 @@
+//===--- TranslationUnitTrace.h - clang-tidy --------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_TRANSLATIONUNITTRACE_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_TRANSLATIONUNITTRACE_H
+
+#include "../clang-tidy/ClangTidyCheck.h"
+#include <string>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+/// Records the phases of the checks as Chrome trace events (viewable in
+/// chrome://tracing or ui.perfetto.dev), one trace file per translation unit.
+///
+/// Enabled by the \c TimeTraceDirectory option, which defaults to the
+/// \c CAOS_TIME_TRACE_DIR environment variable. Events shorter than
+/// \c TimeTraceGranularityUs are only accounted in the totals.
+///
+/// Each check of a translation unit holds one of these: the first one starts
+/// LLVM's time-trace profiler on the current thread, the last one writes the
+/// trace. The phases themselves are \c llvm::TimeTraceScope, which only cost a
+/// thread-local load when tracing is off.
+class TranslationUnitTrace {
+public:
+  /// Begins a "CheckConstruction" event, ended by \c endConstruction().
+  TranslationUnitTrace(const ClangTidyCheck::OptionsView &Options,
+                       StringRef CheckName, StringRef MainFile);
+  ~TranslationUnitTrace();
+
+  TranslationUnitTrace(const TranslationUnitTrace &) = delete;
+  TranslationUnitTrace &operator=(const TranslationUnitTrace &) = delete;
+
+  void endConstruction() const;
+
+  void store(const ClangTidyCheck::OptionsView &Options,
+             ClangTidyOptions::OptionMap &Opts) const;
+
+private:
+  const std::string Directory;
+  const unsigned GranularityUs;
+  const std::string MainFile;
+  /// True if this object took part in starting the session.
+  bool IsSessionMember = false;
+};
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_TRANSLATIONUNITTRACE_H
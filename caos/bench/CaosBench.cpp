@@ -0,0 +1,479 @@
+//===--- CaosBench.cpp - caos-bench ---------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Microbenchmarks of the internals of the CAOS checks: identifier style
+// matching and fixups, declaration type names, option parsing and ignored
+// literal lookups. Inputs are taken from a small, typical student program,
+// parsed once at startup, so that timings are not dominated by parsing.
+//
+// Every benchmark reports the time and the heap allocations per operation
+// (one call of the measured function), and the throughput in operations per
+// second. With -format=json the results can be compared across commits.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../../clang-tidy/ClangTidyDiagnosticConsumer.h"
+#include "../../clang-tidy/ClangTidyOptions.h"
+#include "../IdentifierNamingCheck.h"
+#include "../MagicNumbersCheck.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/raw_ostream.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+// Every heap allocation of the process is counted, so that benchmarks can
+// report allocations per operation.
+static std::atomic<uint64_t> AllocationCount{0};
+
+static void *countedAllocate(std::size_t Size) {
+  AllocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (void *Ptr = std::malloc(Size ? Size : 1))
+    return Ptr;
+  throw std::bad_alloc();
+}
+
+void *operator new(std::size_t Size) { return countedAllocate(Size); }
+void *operator new[](std::size_t Size) { return countedAllocate(Size); }
+void *operator new(std::size_t Size, const std::nothrow_t &) noexcept {
+  AllocationCount.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(Size ? Size : 1);
+}
+void *operator new[](std::size_t Size, const std::nothrow_t &) noexcept {
+  AllocationCount.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(Size ? Size : 1);
+}
+void operator delete(void *Ptr) noexcept { std::free(Ptr); }
+void operator delete[](void *Ptr) noexcept { std::free(Ptr); }
+void operator delete(void *Ptr, std::size_t) noexcept { std::free(Ptr); }
+void operator delete[](void *Ptr, std::size_t) noexcept { std::free(Ptr); }
+void operator delete(void *Ptr, const std::nothrow_t &) noexcept {
+  std::free(Ptr);
+}
+void operator delete[](void *Ptr, const std::nothrow_t &) noexcept {
+  std::free(Ptr);
+}
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+/// Gives the benchmarks access to the private helpers of the check.
+class MagicNumbersCheckBenchmark {
+public:
+  static void parseOptionLists(MagicNumbersCheck &Check) {
+    Check.parseOptionLists();
+  }
+
+  static void parseIgnoredFunctionArgs(MagicNumbersCheck &Check) {
+    Check.IgnoredFunctionArgs.clear();
+    Check.parseIgnoredFunctionArgs();
+  }
+
+  template <typename L>
+  static bool isIgnoredValue(const MagicNumbersCheck &Check,
+                             const L *Literal) {
+    return Check.isIgnoredValue(Literal);
+  }
+};
+
+static cl::OptionCategory CaosBenchCategory("caos-bench options");
+
+static cl::opt<std::string> Filter("filter", cl::desc(R"(
+Regular expression selecting the benchmarks to run.
+)"),
+                                   cl::init(""), cl::cat(CaosBenchCategory));
+
+static cl::opt<unsigned> MinTimeMs("min-time-ms", cl::desc(R"(
+Minimum time each benchmark runs for.
+)"),
+                                   cl::init(200), cl::cat(CaosBenchCategory));
+
+enum class OutputFormat { Text, JSON };
+
+static cl::opt<OutputFormat>
+    Format("format", cl::desc("Output format of the results."),
+           cl::values(clEnumValN(OutputFormat::Text, "text",
+                                 "human-readable table (default)"),
+                      clEnumValN(OutputFormat::JSON, "json",
+                                 "one JSON document with all results")),
+           cl::init(OutputFormat::Text), cl::cat(CaosBenchCategory));
+
+static cl::opt<std::string> OutputFile("output", cl::desc(R"(
+File to write the results to. Defaults to stdout.
+)"),
+                                       cl::init("-"),
+                                       cl::cat(CaosBenchCategory));
+
+// A typical submission: the names and literals of the benchmarks come from
+// here.
+static const char CorpusSource[] = R"c(
+typedef unsigned long size_t;
+long strtol(const char *nptr, char **endptr, int base);
+int open(const char *path, int flags, int mode);
+void *malloc(size_t size);
+void free(void *ptr);
+
+#define BUFFER_SIZE 4096
+#define MAX_ARGS 16
+
+enum TokenKind { TOKEN_WORD, TOKEN_PIPE, TOKEN_REDIRECT_IN, TOKEN_REDIRECT };
+
+struct token {
+    enum TokenKind kind;
+    const char *text;
+    size_t length;
+};
+
+struct CommandLine {
+    struct token tokens[MAX_ARGS];
+    int token_count;
+    double elapsedSeconds;
+};
+
+union Value { int asInt; float asFloat; char bytes[4]; };
+
+static const double kScaleFactor = 1.5;
+static int g_verbose = 0;
+int GlobalCounter = 42;
+
+static int parse_number(const char *text, int *out) {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (*end != '\0' || value > 65535) {
+        return -1;
+    }
+    *out = (int) value;
+    return 0;
+}
+
+int countWords(const char *line, struct CommandLine *cmd) {
+    int inWord = 0;
+    int Count = 0;
+    for (int i = 0; line[i] != '\0' && i < BUFFER_SIZE; ++i) {
+        if (line[i] == ' ' || line[i] == '\t') {
+            inWord = 0;
+        } else if (!inWord) {
+            inWord = 1;
+            cmd->tokens[Count % MAX_ARGS].text = line + i;
+            ++Count;
+        }
+    }
+    cmd->token_count = Count;
+    cmd->elapsedSeconds = Count * 0.25 + kScaleFactor * 3.0;
+    return Count;
+}
+
+int main(int argc, char **argv) {
+    struct CommandLine Cmd;
+    int port = 0;
+    int FD = open("log.txt", 0101, 0644);
+    char *Buffer = malloc(BUFFER_SIZE * 2);
+    if (argc > 1 && parse_number(argv[1], &port) != 0) {
+        return 2;
+    }
+    g_verbose = countWords("ls -l | wc -c > out.txt", &Cmd) > 3;
+    free(Buffer);
+    return FD < 0 ? 1 : 0;
+}
+)c";
+
+// Names in all the styles the check knows about, and some that fit none.
+static const char *const ExtraIdentifiers[] = {
+    "lower_case_name", "UPPER_CASE_NAME", "camelBackName", "CamelCaseName",
+    "Camel_Snake_Case", "camel_Snake_Back", "x", "i", "tmp2", "HTTPServer",
+    "parseHTTPRequest", "__reserved", "trailing_", "m_memberValue",
+    "sz_name", "ALLCAPS", "mixed_Case_name", "a1b2c3", "getIDFromURL",
+    "kDefaultTimeout", "MAX_PATH_LENGTH", "num_of_bytes_read"};
+
+static const char CorpusIgnoredFunctionArgs[] =
+    "strtol;3;d;strtoll;3;d;strtoul;3;d;open;3;o;creat;2;o;chmod;2;o;"
+    "fchmod;2;o;mkdir;2;o;umask;1;o;mmap;3;a;mmap;4;a;lseek;3;d;"
+    "socket;1;a;socket;2;a;setsockopt;3;a;kill;2;d";
+
+namespace {
+
+/// Literals and declarations of the corpus.
+struct Corpus {
+  std::unique_ptr<ASTUnit> AST;
+  std::vector<const IntegerLiteral *> IntegerLiterals;
+  std::vector<const FloatingLiteral *> FloatingLiterals;
+  std::vector<const NamedDecl *> Decls;
+  std::vector<std::string> Identifiers;
+};
+
+class CorpusCollector : public RecursiveASTVisitor<CorpusCollector> {
+public:
+  explicit CorpusCollector(Corpus &C) : C(C) {}
+
+  bool VisitIntegerLiteral(IntegerLiteral *Literal) {
+    C.IntegerLiterals.push_back(Literal);
+    return true;
+  }
+  bool VisitFloatingLiteral(FloatingLiteral *Literal) {
+    C.FloatingLiterals.push_back(Literal);
+    return true;
+  }
+  bool VisitNamedDecl(NamedDecl *Decl) {
+    if (Decl->getIdentifier() &&
+        Decl->getASTContext().getSourceManager().isInMainFile(
+            Decl->getLocation())) {
+      C.Decls.push_back(Decl);
+      C.Identifiers.push_back(Decl->getName().str());
+    }
+    return true;
+  }
+
+private:
+  Corpus &C;
+};
+
+/// A benchmark runs \c Body repeatedly; each run performs \c OpsPerRun
+/// operations.
+struct Benchmark {
+  std::string Name;
+  size_t OpsPerRun;
+  std::function<void()> Body;
+};
+
+struct Result {
+  std::string Name;
+  uint64_t Operations;
+  double NanosecondsPerOp;
+  double AllocationsPerOp;
+  double OpsPerSecond;
+};
+
+} // namespace
+
+static Corpus buildCorpus() {
+  Corpus C;
+  C.AST = tooling::buildASTFromCodeWithArgs(CorpusSource, {"-std=c11"},
+                                            "corpus.c");
+  if (!C.AST) {
+    errs() << "caos-bench: cannot parse the corpus\n";
+    std::exit(1);
+  }
+  CorpusCollector(C).TraverseAST(C.AST->getASTContext());
+  for (const char *Name : ExtraIdentifiers)
+    C.Identifiers.push_back(Name);
+  return C;
+}
+
+// Keeps the compiler from optimizing away the benchmarked computation.
+template <typename T> static void doNotOptimize(const T &Value) {
+  asm volatile("" : : "r,m"(Value) : "memory");
+}
+
+static Result runBenchmark(const Benchmark &B) {
+  using Clock = std::chrono::steady_clock;
+  // Warm up caches and lazily initialized state (e.g. static regexes).
+  B.Body();
+
+  const auto MinTime = std::chrono::milliseconds(MinTimeMs);
+  uint64_t Runs = 0;
+  uint64_t BatchSize = 1;
+  const uint64_t AllocationsBefore = AllocationCount.load();
+  const Clock::time_point Start = Clock::now();
+  Clock::duration Elapsed;
+  // Batches grow so that the clock is read rarely once runs are known to be
+  // fast.
+  do {
+    for (uint64_t I = 0; I < BatchSize; ++I)
+      B.Body();
+    Runs += BatchSize;
+    BatchSize = std::min<uint64_t>(BatchSize * 2, 1024);
+    Elapsed = Clock::now() - Start;
+  } while (Elapsed < MinTime);
+  const uint64_t Allocations = AllocationCount.load() - AllocationsBefore;
+
+  const uint64_t Ops = Runs * B.OpsPerRun;
+  const double Nanoseconds =
+      std::chrono::duration<double, std::nano>(Elapsed).count();
+  return {B.Name, Ops, Nanoseconds / Ops, double(Allocations) / Ops,
+          Ops * 1e9 / Nanoseconds};
+}
+
+static std::vector<IdentifierNamingCheck::NamingStyle>
+makeStyles(ArrayRef<IdentifierNamingCheck::CaseType> Cases) {
+  std::vector<IdentifierNamingCheck::NamingStyle> Styles;
+  for (IdentifierNamingCheck::CaseType Case : Cases)
+    Styles.emplace_back(Case, "", "", "",
+                        IdentifierNamingCheck::HungarianPrefixType::HPT_Off);
+  return Styles;
+}
+
+static std::vector<Benchmark>
+makeBenchmarks(const Corpus &C, const IdentifierNamingCheck &Naming,
+               MagicNumbersCheck &MagicNumbers) {
+  using NamingStyle = IdentifierNamingCheck::NamingStyle;
+  static const IdentifierNamingCheck::CaseType Cases[] = {
+      IdentifierNamingCheck::CT_LowerCase,
+      IdentifierNamingCheck::CT_CamelBack,
+      IdentifierNamingCheck::CT_UpperCase,
+      IdentifierNamingCheck::CT_CamelCase,
+      IdentifierNamingCheck::CT_CamelSnakeCase,
+      IdentifierNamingCheck::CT_CamelSnakeBack};
+  static const std::vector<NamingStyle> Styles = makeStyles(Cases);
+  static const IdentifierNamingCheck::HungarianNotationOption HNOption;
+
+  const size_t NumPairs = C.Identifiers.size() * Styles.size();
+  std::vector<Benchmark> Benchmarks;
+
+  Benchmarks.push_back(
+      {"IdentifierNaming/matchesStyle", NumPairs, [&C, &Naming] {
+         for (const std::string &Name : C.Identifiers)
+           for (const NamingStyle &Style : Styles)
+             doNotOptimize(
+                 Naming.matchesStyle("", Name, Style, HNOption, nullptr));
+       }});
+
+  Benchmarks.push_back(
+      {"IdentifierNaming/fixupWithCase", NumPairs, [&C, &Naming] {
+         for (const std::string &Name : C.Identifiers)
+           for (size_t I = 0; I < Styles.size(); ++I)
+             doNotOptimize(Naming.fixupWithCase("", Name, nullptr, Styles[I],
+                                                HNOption, Cases[I]));
+       }});
+
+  Benchmarks.push_back(
+      {"IdentifierNaming/getDeclTypeName", C.Decls.size(), [&C] {
+         IdentifierNamingCheck::HungarianNotation HN;
+         for (const NamedDecl *Decl : C.Decls)
+           doNotOptimize(HN.getDeclTypeName(Decl));
+       }});
+
+  Benchmarks.push_back(
+      {"MagicNumbers/parseIgnoredFunctionArgs", 1, [&MagicNumbers] {
+         MagicNumbersCheckBenchmark::parseIgnoredFunctionArgs(MagicNumbers);
+       }});
+
+  Benchmarks.push_back({"MagicNumbers/isIgnoredValue/integer",
+                        C.IntegerLiterals.size(), [&C, &MagicNumbers] {
+                          for (const IntegerLiteral *Literal :
+                               C.IntegerLiterals)
+                            doNotOptimize(
+                                MagicNumbersCheckBenchmark::isIgnoredValue(
+                                    MagicNumbers, Literal));
+                        }});
+
+  Benchmarks.push_back({"MagicNumbers/isIgnoredValue/float",
+                        C.FloatingLiterals.size(), [&C, &MagicNumbers] {
+                          for (const FloatingLiteral *Literal :
+                               C.FloatingLiterals)
+                            doNotOptimize(
+                                MagicNumbersCheckBenchmark::isIgnoredValue(
+                                    MagicNumbers, Literal));
+                        }});
+
+  return Benchmarks;
+}
+
+static void printText(raw_ostream &OS, ArrayRef<Result> Results) {
+  OS << formatv("{0,-42} {1,14} {2,12} {3,12} {4,14}\n", "benchmark", "ops",
+                "ns/op", "allocs/op", "ops/s");
+  for (const Result &R : Results)
+    OS << formatv("{0,-42} {1,14} {2,12:f2} {3,12:f2} {4,14:f0}\n", R.Name,
+                  R.Operations, R.NanosecondsPerOp, R.AllocationsPerOp,
+                  R.OpsPerSecond);
+}
+
+static void printJSON(raw_ostream &OS, ArrayRef<Result> Results) {
+  json::OStream J(OS, /*IndentSize=*/2);
+  J.object([&] {
+    J.attribute("min_time_ms", MinTimeMs.getValue());
+    J.attributeArray("benchmarks", [&] {
+      for (const Result &R : Results)
+        J.object([&] {
+          J.attribute("name", R.Name);
+          J.attribute("operations", R.Operations);
+          J.attribute("ns_per_op", R.NanosecondsPerOp);
+          J.attribute("allocs_per_op", R.AllocationsPerOp);
+          J.attribute("ops_per_second", R.OpsPerSecond);
+        });
+    });
+  });
+  OS << '\n';
+}
+
+static int caosBenchMain(int Argc, const char **Argv) {
+  InitLLVM X(Argc, Argv);
+  cl::HideUnrelatedOptions(CaosBenchCategory);
+  cl::ParseCommandLineOptions(
+      Argc, Argv, "Microbenchmarks of the CAOS clang-tidy check internals.\n");
+
+  Regex FilterRegex(Filter);
+  std::string RegexError;
+  if (!FilterRegex.isValid(RegexError)) {
+    errs() << "caos-bench: invalid -filter: " << RegexError << "\n";
+    return 1;
+  }
+
+  std::error_code EC;
+  raw_fd_ostream Output(OutputFile, EC, sys::fs::OF_None);
+  if (EC) {
+    errs() << "caos-bench: cannot open " << OutputFile << ": " << EC.message()
+           << "\n";
+    return 1;
+  }
+
+  ClangTidyOptions Options = ClangTidyOptions::getDefaults();
+  Options.Checks = "-*,caos-*";
+  Options.CheckOptions["caos-magic-numbers.IgnoredFunctionArgs"] =
+      ClangTidyOptions::ClangTidyValue(CorpusIgnoredFunctionArgs);
+  ClangTidyContext Context(std::make_unique<DefaultOptionsProvider>(
+      ClangTidyGlobalOptions(), Options));
+  ClangTidyDiagnosticConsumer DiagConsumer(Context);
+  DiagnosticsEngine DiagEngine(new DiagnosticIDs, new DiagnosticOptions,
+                               &DiagConsumer, /*ShouldOwnClient=*/false);
+  Context.setDiagnosticsEngine(&DiagEngine);
+  Context.setCurrentFile("corpus.c");
+
+  Corpus C = buildCorpus();
+  // The corpus is C, so the checks are those the module creates for C.
+  IdentifierNamingCheckFor<CLanguagePolicy> Naming("caos-identifier-naming",
+                                                   &Context);
+  MagicNumbersCheckFor<CLanguagePolicy> MagicNumbers("caos-magic-numbers",
+                                                     &Context);
+  // The check parses its option lists on the first literal it is given.
+  MagicNumbersCheckBenchmark::parseOptionLists(MagicNumbers);
+
+  std::vector<Result> Results;
+  for (const Benchmark &B : makeBenchmarks(C, Naming, MagicNumbers))
+    if (FilterRegex.match(B.Name))
+      Results.push_back(runBenchmark(B));
+
+  if (Format == OutputFormat::JSON)
+    printJSON(Output, Results);
+  else
+    printText(Output, Results);
+  return 0;
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+int main(int Argc, const char **Argv) {
+  return clang::tidy::caos::caosBenchMain(Argc, Argv);
+}
@@ -0,0 +1,294 @@
+//===--- CorpusGenerator.cpp - caos-corpus-gen ----------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Generates synthetic C translation units that look like student code, for
+// the end-to-end benchmarks of the CAOS checks. The size and shape of the
+// output (number of functions, literal density, initializer tables, macro
+// expansions, identifier styles, nesting depth, Hungarian notation) are set on
+// the command line. The output only depends on the options and the seed.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/raw_ostream.h"
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+static cl::OptionCategory GeneratorCategory("caos-corpus-gen options");
+
+static cl::opt<unsigned> Functions("functions",
+                                   cl::desc("Number of functions."),
+                                   cl::init(100), cl::cat(GeneratorCategory));
+
+static cl::opt<unsigned> LiteralDensity("literal-density", cl::desc(R"(
+Numeric literals per statement, in percent.
+)"),
+                                        cl::init(50),
+                                        cl::cat(GeneratorCategory));
+
+static cl::opt<unsigned> Statements("statements",
+                                    cl::desc("Statements per function body."),
+                                    cl::init(10), cl::cat(GeneratorCategory));
+
+static cl::opt<unsigned> TableSize("table-size", cl::desc(R"(
+Entries of the constant initializer table of each
+function (0 for none).
+)"),
+                                   cl::init(8), cl::cat(GeneratorCategory));
+
+static cl::opt<unsigned> MacroExpansions("macro-expansions", cl::desc(R"(
+Expansions of function-like macros with literals in
+their bodies, per function.
+)"),
+                                         cl::init(2),
+                                         cl::cat(GeneratorCategory));
+
+static cl::opt<unsigned> Nesting("nesting", cl::desc(R"(
+Depth of the nested loops and conditions each
+function body is wrapped in.
+)"),
+                                 cl::init(2), cl::cat(GeneratorCategory));
+
+enum class NameStyle { Mixed, LowerCase, UpperCase, CamelBack, CamelCase };
+
+static cl::opt<NameStyle> Style(
+    "style", cl::desc("Style of the generated identifiers."),
+    cl::values(
+        clEnumValN(NameStyle::Mixed, "mixed", "a random style per name"),
+        clEnumValN(NameStyle::LowerCase, "lower_case", "lower_case"),
+        clEnumValN(NameStyle::UpperCase, "UPPER_CASE", "UPPER_CASE"),
+        clEnumValN(NameStyle::CamelBack, "camelBack", "camelBack"),
+        clEnumValN(NameStyle::CamelCase, "CamelCase", "CamelCase")),
+    cl::init(NameStyle::Mixed), cl::cat(GeneratorCategory));
+
+static cl::opt<bool> Hungarian("hungarian", cl::desc(R"(
+Add Hungarian-style declarations (iCount, szName,
+ulSize, ...) to every function.
+)"),
+                               cl::init(false), cl::cat(GeneratorCategory));
+
+static cl::opt<unsigned> Seed("seed", cl::desc("Random seed."), cl::init(1),
+                              cl::cat(GeneratorCategory));
+
+static cl::opt<std::string> OutputFile("o", cl::desc("Output file."),
+                                       cl::value_desc("file"), cl::init("-"),
+                                       cl::cat(GeneratorCategory));
+
+static const StringRef Words[] = {
+    "buffer", "count", "index", "value",  "offset", "size",  "total",
+    "result", "state", "token", "length", "flag",   "child", "pipe",
+    "signal", "path",  "mode",  "bytes",  "line",   "entry"};
+
+namespace {
+
+class Generator {
+public:
+  explicit Generator(raw_ostream &OS) : OS(OS), Rng(Seed) {}
+
+  void run() {
+    OS << "// Generated by caos-corpus-gen.\n\n";
+    OS << "typedef unsigned long size_t;\n"
+       << "long strtol(const char *nptr, char **endptr, int base);\n\n";
+    writeMacros();
+    for (unsigned F = 0; F < Functions; ++F)
+      writeFunction();
+    writeMain();
+  }
+
+private:
+  unsigned random(unsigned Bound) { return Bound == 0 ? 0 : Rng() % Bound; }
+  bool percent(unsigned Percent) { return random(100) < Percent; }
+
+  std::string literal() {
+    if (percent(20))
+      return std::to_string(random(1000)) + "." + std::to_string(random(100));
+    switch (random(4)) {
+    case 0:
+      return "0x" + utohexstr(random(65536), /*LowerCase=*/true);
+    case 1:
+      return std::to_string(random(10));
+    default:
+      return std::to_string(random(100000));
+    }
+  }
+
+  // Returns a new name made of two words and a counter, in the configured
+  // style.
+  std::string name() {
+    StringRef First = Words[random(std::size(Words))];
+    StringRef Second = Words[random(std::size(Words))];
+    NameStyle S = Style;
+    if (S == NameStyle::Mixed)
+      S = static_cast<NameStyle>(1 + random(4));
+
+    std::string Result;
+    switch (S) {
+    case NameStyle::Mixed:
+    case NameStyle::LowerCase:
+      Result = (First + "_" + Second).str();
+      break;
+    case NameStyle::UpperCase:
+      Result = (First.upper() + "_" + Second.upper());
+      break;
+    case NameStyle::CamelBack:
+      Result =
+          (First + Second.substr(0, 1).upper() + Second.drop_front()).str();
+      break;
+    case NameStyle::CamelCase:
+      Result = (First.substr(0, 1).upper() + First.drop_front() +
+                Second.substr(0, 1).upper() + Second.drop_front())
+                   .str();
+      break;
+    }
+    return Result + std::to_string(NameCount++);
+  }
+
+  void indent(unsigned Depth) { OS.indent(4 * Depth); }
+
+  void writeMacros() {
+    for (unsigned M = 0; M < 4; ++M)
+      OS << "#define SCALE_" << M << "(x) ((x) * " << literal() << " + "
+         << literal() << ")\n";
+    OS << "\n";
+  }
+
+  void writeHungarianDecls(unsigned Depth) {
+    static const char *const Decls[] = {
+        "int iCount = 0;",         "unsigned long ulSize = 0;",
+        "const char *szName = 0;", "float fRatio = 0;",
+        "char cSeparator = 0;",    "unsigned char *pucData = 0;",
+        "double dAverage = 0;",    "short sDelta = 0;"};
+    for (const char *Decl : Decls) {
+      indent(Depth);
+      OS << Decl << "\n";
+    }
+  }
+
+  void writeStatement(unsigned Depth, StringRef Accumulator,
+                      StringRef Parameter) {
+    indent(Depth);
+    OS << Accumulator << " += " << Parameter;
+    if (percent(LiteralDensity))
+      OS << " * " << literal();
+    if (percent(LiteralDensity))
+      OS << " - " << literal();
+    OS << ";\n";
+  }
+
+  void writeFunction() {
+    std::string Function = name();
+    std::string Parameter = name();
+    std::string Accumulator = name();
+    std::string Table = name();
+
+    if (TableSize > 0) {
+      OS << "static const int " << Table << "[" << TableSize << "] = {";
+      for (unsigned I = 0; I < TableSize; ++I)
+        OS << (I == 0 ? "" : ", ") << random(100000);
+      OS << "};\n";
+    }
+
+    OS << "int " << Function << "(int " << Parameter << ") {\n";
+    indent(1);
+    OS << "long " << Accumulator << " = " << literal() << ";\n";
+    if (Hungarian)
+      writeHungarianDecls(1);
+
+    // Open the nested scopes, alternating loops and conditions.
+    for (unsigned D = 0; D < Nesting; ++D) {
+      indent(D + 1);
+      if (D % 2 == 0)
+        OS << "for (int i" << D << " = 0; i" << D << " < " << literal()
+           << "; ++i" << D << ") {\n";
+      else
+        OS << "if (" << Accumulator << " > " << literal() << ") {\n";
+    }
+
+    const unsigned Depth = Nesting + 1;
+    for (unsigned S = 0; S < Statements; ++S)
+      writeStatement(Depth, Accumulator, Parameter);
+    for (unsigned M = 0; M < MacroExpansions; ++M) {
+      indent(Depth);
+      OS << Accumulator << " = SCALE_" << random(4) << "(" << Accumulator
+         << ");\n";
+    }
+    if (TableSize > 0) {
+      indent(Depth);
+      OS << Accumulator << " += " << Table << "[" << Parameter << " % "
+         << TableSize << "];\n";
+    }
+
+    for (unsigned D = Nesting; D > 0; --D) {
+      indent(D);
+      OS << "}\n";
+    }
+    indent(1);
+    OS << "return (int) " << Accumulator << ";\n";
+    OS << "}\n\n";
+    FunctionNames.push_back(std::move(Function));
+  }
+
+  void writeMain() {
+    OS << "int main(int argc, char **argv) {\n";
+    indent(1);
+    OS << "int status = (int) strtol(argc > 1 ? argv[1] : \"0\", 0, 10);\n";
+    for (const std::string &Function : FunctionNames) {
+      indent(1);
+      OS << "status ^= " << Function << "(status);\n";
+    }
+    indent(1);
+    OS << "return status != 0;\n";
+    OS << "}\n";
+  }
+
+  raw_ostream &OS;
+  std::mt19937 Rng;
+  unsigned NameCount = 0;
+  std::vector<std::string> FunctionNames;
+};
+
+} // namespace
+
+static int corpusGeneratorMain(int Argc, const char **Argv) {
+  InitLLVM X(Argc, Argv);
+  cl::HideUnrelatedOptions(GeneratorCategory);
+  cl::ParseCommandLineOptions(
+      Argc, Argv, "Generates a synthetic C translation unit for benchmarks.\n");
+
+  std::error_code EC;
+  raw_fd_ostream Output(OutputFile, EC, sys::fs::OF_Text);
+  if (EC) {
+    errs() << "caos-corpus-gen: cannot open " << OutputFile << ": "
+           << EC.message() << "\n";
+    return 1;
+  }
+  Generator(Output).run();
+  return 0;
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+int main(int Argc, const char **Argv) {
+  return clang::tidy::caos::corpusGeneratorMain(Argc, Argv);
+}
@@ -0,0 +1,111 @@
+#!/bin/bash
+
+# Runs the CAOS checks and the upstream readability checks they were forked
+# from over the same sources, and reports their throughput, peak RSS and the
+# differences between their findings side by side.
+#
+# Usage: caos/bench/compare-upstream.sh [sources...]
+# Without sources, a corpus of FUNCTIONS functions is generated with
+# caos-corpus-gen (Hungarian declarations included) and test/*.c is added.
+# Environment:
+#   BUILD_DIR   build directory (default: build)
+#   CLANG_TIDY  clang-tidy binary (default: clang-tidy-17)
+#   FUNCTIONS   size of the generated corpus (default: 2000)
+#   REPEAT      runs per check, the fastest is reported (default: 3)
+#   KEEP_DIFF   directory to keep the differing findings in (default: none)
+
+set -eu
+
+BUILD_DIR=${BUILD_DIR:-build}
+CLANG_TIDY=${CLANG_TIDY:-clang-tidy-17}
+FUNCTIONS=${FUNCTIONS:-2000}
+REPEAT=${REPEAT:-3}
+KEEP_DIFF=${KEEP_DIFF:-}
+
+PLUGIN="$BUILD_DIR/caos/libclangTidyCaosModule.so"
+GENERATOR="$BUILD_DIR/caos/bench/caos-corpus-gen"
+
+# The same options are given to both implementations of each check.
+NAMING_OPTIONS="VariableCase: lower_case, GlobalVariableCase: lower_case, \
+FunctionCase: lower_case, ParameterCase: lower_case, \
+MacroDefinitionCase: UPPER_CASE, StructCase: CamelCase, UnionCase: CamelCase, \
+TypedefCase: lower_case, EnumConstantCase: UPPER_CASE"
+CHECK_OPTIONS=""
+for prefix in caos-identifier-naming readability-identifier-naming; do
+    IFS=',' read -ra options <<< "$NAMING_OPTIONS"
+    for option in "${options[@]}"; do
+        CHECK_OPTIONS="$CHECK_OPTIONS$prefix.${option# }, "
+    done
+done
+CONFIG="{CheckOptions: {${CHECK_OPTIONS%, }}}"
+
+PAIRS=(
+    "caos-magic-numbers readability-magic-numbers"
+    "caos-identifier-naming readability-identifier-naming"
+)
+
+if [ ! -f "$PLUGIN" ]; then
+    echo "$PLUGIN not found, build it first (make clangTidyCaosModule)" >&2
+    exit 1
+fi
+
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+SOURCES=("$@")
+if [ ${#SOURCES[@]} -eq 0 ]; then
+    if [ ! -x "$GENERATOR" ]; then
+        echo "$GENERATOR not found, build it first (make caos-corpus-gen)" >&2
+        exit 1
+    fi
+    "$GENERATOR" -functions="$FUNCTIONS" -hungarian -o "$WORK_DIR/corpus.c"
+    SOURCES=("$WORK_DIR/corpus.c" test/*.c)
+fi
+LINES=$(cat "${SOURCES[@]}" | wc -l)
+
+# Runs one check REPEAT times; leaves "seconds rss_kb" of the fastest run in
+# $WORK_DIR/<check>.time and its findings, as sorted "file:line:col" lines, in
+# $WORK_DIR/<check>.findings.
+run_check() {
+    local check=$1
+    local best=""
+    for _ in $(seq "$REPEAT"); do
+        /usr/bin/time -f "%e %M" -o "$WORK_DIR/time" \
+            "$CLANG_TIDY" --load "$PLUGIN" --checks="-*,$check" \
+            --config="$CONFIG" --quiet "${SOURCES[@]}" -- -std=c11 \
+            > "$WORK_DIR/output" 2> /dev/null || true
+        read -r seconds rss < "$WORK_DIR/time"
+        if [ -z "$best" ] || awk "BEGIN { exit !($seconds < $best) }"; then
+            best=$seconds
+            echo "$seconds $rss" > "$WORK_DIR/$check.time"
+            grep -oE "^[^ ]+:[0-9]+:[0-9]+: warning: .*\[$check" \
+                "$WORK_DIR/output" | cut -d: -f1-3 | sort -u \
+                > "$WORK_DIR/$check.findings" || true
+        fi
+    done
+}
+
+echo "$LINES lines in ${#SOURCES[@]} files, best of $REPEAT runs"
+printf "%-30s %9s %12s %12s %9s %11s\n" \
+    check seconds lines/s peak_rss_kb findings only_this
+for pair in "${PAIRS[@]}"; do
+    read -r caos upstream <<< "$pair"
+    run_check "$caos"
+    run_check "$upstream"
+    for check in "$caos" "$upstream"; do
+        other=$([ "$check" = "$caos" ] && echo "$upstream" || echo "$caos")
+        read -r seconds rss < "$WORK_DIR/$check.time"
+        findings=$(wc -l < "$WORK_DIR/$check.findings")
+        comm -23 "$WORK_DIR/$check.findings" "$WORK_DIR/$other.findings" \
+            > "$WORK_DIR/$check.only"
+        only=$(wc -l < "$WORK_DIR/$check.only")
+        throughput=$(awk -v l="$LINES" -v s="$seconds" \
+            'BEGIN { if (s > 0) printf "%.0f", l / s; else print "-" }')
+        printf "%-30s %9s %12s %12s %9s %11s\n" \
+            "$check" "$seconds" "$throughput" "$rss" "$findings" "$only"
+        if [ -n "$KEEP_DIFF" ]; then
+            mkdir -p "$KEEP_DIFF"
+            cp "$WORK_DIR/$check.only" "$KEEP_DIFF/only-$check.txt"
+        fi
+    done
+done
@@ -0,0 +1,54 @@
+#!/bin/bash
+
+# Builds a profile-guided, ThinLTO-optimised caos-clang-tidy:
+#   1. builds an instrumented caos-clang-tidy in $PGO_BUILD_DIR,
+#   2. trains it on generated corpora and the given sources (test/*.c if none),
+#   3. merges the profile and rebuilds caos-clang-tidy in $BUILD_DIR with it.
+#
+# Usage: caos/bench/pgo-train.sh [training sources...]
+# Environment:
+#   BUILD_DIR      final build directory (default: build)
+#   PGO_BUILD_DIR  instrumented build directory (default: build-pgo-gen)
+#   LLVM_PROFDATA  llvm-profdata binary (default: llvm-profdata-17)
+#   SIZES          generated corpus sizes, in functions (default: 100 500 2000)
+
+set -eu
+
+BUILD_DIR=${BUILD_DIR:-build}
+PGO_BUILD_DIR=${PGO_BUILD_DIR:-build-pgo-gen}
+LLVM_PROFDATA=${LLVM_PROFDATA:-llvm-profdata-17}
+SIZES=${SIZES:-100 500 2000}
+
+PROFILE_DIR="$PWD/$PGO_BUILD_DIR/profiles"
+PROFILE="$PWD/$PGO_BUILD_DIR/caos-clang-tidy.profdata"
+
+cmake -B "$PGO_BUILD_DIR" -DCMAKE_BUILD_TYPE=Release -DCAOS_PGO_GENERATE=ON
+make -C "$PGO_BUILD_DIR" -j "$(nproc)" caos-clang-tidy caos-corpus-gen
+
+SOURCES=("$@")
+if [ ${#SOURCES[@]} -eq 0 ]; then
+    SOURCES=(test/*.c)
+fi
+for size in $SIZES; do
+    corpus="$PGO_BUILD_DIR/corpus-$size.c"
+    "$PGO_BUILD_DIR/caos/bench/caos-corpus-gen" -functions="$size" \
+        -hungarian -seed="$size" -o "$corpus"
+    SOURCES+=("$corpus")
+done
+
+# Train with the options of the course, so that the profile follows the paths
+# taken when grading.
+rm -rf "$PROFILE_DIR"
+for source in "${SOURCES[@]}"; do
+    LLVM_PROFILE_FILE="$PROFILE_DIR/%p.profraw" \
+        "$PGO_BUILD_DIR/caos/tool/caos-clang-tidy" \
+        --config="{CheckOptions: {caos-identifier-naming.UnionCase: CamelCase, caos-identifier-naming.StructCase: CamelCase}}" \
+        --checks="-*,caos-magic-numbers,caos-identifier-naming" --quiet \
+        "$source" -- > /dev/null 2>&1 || true
+done
+"$LLVM_PROFDATA" merge -o "$PROFILE" "$PROFILE_DIR"/*.profraw
+
+cmake -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Release -DCAOS_PGO_GENERATE=OFF \
+    -DCAOS_PGO_PROFILE="$PROFILE" -DCAOS_THINLTO=ON
+make -C "$BUILD_DIR" -j "$(nproc)" caos-clang-tidy
+echo "Optimised binary: $BUILD_DIR/caos/tool/caos-clang-tidy"
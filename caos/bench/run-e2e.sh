@@ -0,0 +1,76 @@
+#!/bin/bash
+
+# End-to-end benchmark: runs the CAOS checks over generated translation units
+# of increasing size and reports wall time, peak RSS and the scaling exponent
+# between consecutive sizes (1 is linear, 2 quadratic).
+#
+# Usage: caos/bench/run-e2e.sh [sizes...] [-- caos-corpus-gen options...]
+# Environment:
+#   BUILD_DIR   build directory (default: build)
+#   CLANG_TIDY  clang-tidy binary (default: clang-tidy-17)
+#   CHECKS      checks to run (default: caos-magic-numbers,caos-identifier-naming)
+#   REPEAT      runs per size, the fastest is reported (default: 3)
+
+set -eu
+
+BUILD_DIR=${BUILD_DIR:-build}
+CLANG_TIDY=${CLANG_TIDY:-clang-tidy-17}
+CHECKS=${CHECKS:-caos-magic-numbers,caos-identifier-naming}
+REPEAT=${REPEAT:-3}
+
+PLUGIN="$BUILD_DIR/caos/libclangTidyCaosModule.so"
+GENERATOR="$BUILD_DIR/caos/bench/caos-corpus-gen"
+
+SIZES=()
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do
+    SIZES+=("$1")
+    shift
+done
+[ $# -gt 0 ] && shift
+if [ ${#SIZES[@]} -eq 0 ]; then
+    SIZES=(125 250 500 1000 2000 4000)
+fi
+
+for file in "$PLUGIN" "$GENERATOR"; do
+    if [ ! -x "$file" ] && [ ! -f "$file" ]; then
+        echo "$file not found, build it first (make clangTidyCaosModule caos-corpus-gen)" >&2
+        exit 1
+    fi
+done
+
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+printf "%10s %10s %10s %12s %10s\n" functions lines seconds peak_rss_kb exponent
+PREV_LINES=""
+PREV_SECONDS=""
+for size in "${SIZES[@]}"; do
+    source_file="$WORK_DIR/corpus-$size.c"
+    "$GENERATOR" -functions="$size" -o "$source_file" "$@"
+    lines=$(wc -l < "$source_file")
+
+    best_seconds=""
+    best_rss=""
+    for _ in $(seq "$REPEAT"); do
+        # Findings are expected; only the resources are of interest.
+        /usr/bin/time -f "%e %M" -o "$WORK_DIR/time" \
+            "$CLANG_TIDY" --load "$PLUGIN" --checks="-*,$CHECKS" --quiet \
+            "$source_file" -- -std=c11 > /dev/null 2>&1 || true
+        read -r seconds rss < "$WORK_DIR/time"
+        if [ -z "$best_seconds" ] || awk "BEGIN { exit !($seconds < $best_seconds) }"; then
+            best_seconds=$seconds
+        fi
+        if [ -z "$best_rss" ] || [ "$rss" -lt "$best_rss" ]; then
+            best_rss=$rss
+        fi
+    done
+
+    exponent=$(awk -v l="$lines" -v s="$best_seconds" \
+        -v pl="$PREV_LINES" -v ps="$PREV_SECONDS" 'BEGIN {
+            if (pl == "" || ps <= 0 || s <= 0) print "-";
+            else printf "%.2f", log(s / ps) / log(l / pl);
+        }')
+    printf "%10s %10s %10s %12s %10s\n" "$size" "$lines" "$best_seconds" "$best_rss" "$exponent"
+    PREV_LINES=$lines
+    PREV_SECONDS=$best_seconds
+done
@@ -0,0 +1,171 @@
+//===--- ArchiveFileSystem.cpp - caos-batch -------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "ArchiveFileSystem.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include <algorithm>
+#include <optional>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+static constexpr size_t BlockSize = 512;
+
+// Offsets of the ustar header fields we need.
+static constexpr size_t NameOffset = 0, NameSize = 100;
+static constexpr size_t SizeOffset = 124, SizeSize = 12;
+static constexpr size_t TypeFlagOffset = 156;
+static constexpr size_t MagicOffset = 257;
+static constexpr size_t PrefixOffset = 345, PrefixSize = 155;
+
+static StringRef getField(const char *Header, size_t Offset, size_t Size) {
+  return StringRef(Header + Offset, Size).take_until([](char C) {
+    return C == '\0';
+  });
+}
+
+static bool isZeroBlock(const char *Header) {
+  return std::all_of(Header, Header + BlockSize,
+                     [](char C) { return C == '\0'; });
+}
+
+// Returns the value of the "path" record of a PAX extended header, if any.
+static std::optional<StringRef> getPaxPath(StringRef Records) {
+  // Each record is "<length> <key>=<value>\n", where <length> covers the whole
+  // record including itself.
+  while (!Records.empty()) {
+    size_t Length;
+    StringRef LengthStr = Records.take_until([](char C) { return C == ' '; });
+    if (LengthStr.getAsInteger(10, Length) || Length > Records.size() ||
+        Length <= LengthStr.size() + 1)
+      return std::nullopt;
+    StringRef Record =
+        Records.take_front(Length).drop_front(LengthStr.size() + 1);
+    Records = Records.drop_front(Length);
+    Record.consume_back("\n");
+    auto [Key, Value] = Record.split('=');
+    if (Key == "path")
+      return Value;
+  }
+  return std::nullopt;
+}
+
+llvm::Expected<std::unique_ptr<TarArchive>>
+TarArchive::open(StringRef Path) {
+  uint64_t Size;
+  if (std::error_code EC = llvm::sys::fs::file_size(Path, Size))
+    return llvm::createFileError(Path, EC);
+  if (Size == 0)
+    return std::unique_ptr<TarArchive>(
+        new TarArchive(llvm::sys::fs::mapped_file_region()));
+
+  llvm::Expected<llvm::sys::fs::file_t> FD =
+      llvm::sys::fs::openNativeFileForRead(Path);
+  if (!FD)
+    return llvm::createFileError(Path, FD.takeError());
+
+  std::error_code EC;
+  llvm::sys::fs::mapped_file_region Region(
+      *FD, llvm::sys::fs::mapped_file_region::readonly, Size, 0, EC);
+  // The mapping keeps its own reference to the file.
+  llvm::sys::fs::closeFile(*FD);
+  if (EC)
+    return llvm::createFileError(Path, EC);
+
+  std::unique_ptr<TarArchive> Archive(new TarArchive(std::move(Region)));
+  if (llvm::Error Err = Archive->index())
+    return llvm::createFileError(Path, std::move(Err));
+  return std::move(Archive);
+}
+
+llvm::Error TarArchive::index() {
+  const char *Begin = Region.const_data();
+  const size_t Size = Region.size();
+  // Name of the next member set by a preceding GNU long name ('L') or PAX
+  // extended ('x') header.
+  std::string PendingName;
+
+  for (size_t Offset = 0; Offset + BlockSize <= Size;) {
+    const char *Header = Begin + Offset;
+    if (isZeroBlock(Header))
+      break;
+
+    uint64_t MemberSize;
+    if (getField(Header, SizeOffset, SizeSize)
+            .trim(' ')
+            .getAsInteger(8, MemberSize))
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "invalid member size at offset %zu",
+                                     Offset);
+
+    const size_t DataOffset = Offset + BlockSize;
+    if (MemberSize > Size - DataOffset)
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "truncated member at offset %zu", Offset);
+    StringRef Data(Begin + DataOffset, MemberSize);
+
+    switch (Header[TypeFlagOffset]) {
+    case 'L':
+      PendingName = Data.take_until([](char C) { return C == '\0'; }).str();
+      break;
+    case 'x':
+      if (std::optional<StringRef> Path = getPaxPath(Data))
+        PendingName = Path->str();
+      break;
+    case '0':
+    case '\0':
+    case '7': {
+      std::string Name = std::move(PendingName);
+      PendingName.clear();
+      if (Name.empty()) {
+        StringRef Prefix = getField(Header, PrefixOffset, PrefixSize);
+        if (getField(Header, MagicOffset, 5) == "ustar" && !Prefix.empty())
+          Name = (Prefix + "/").str();
+        Name += getField(Header, NameOffset, NameSize);
+      }
+      StringRef Relative = Name;
+      while (Relative.consume_front("./"))
+        ;
+      const size_t End = DataOffset + MemberSize;
+      Members.push_back({Relative.str(), Data, End < Size && Begin[End] == 0});
+      break;
+    }
+    default:
+      // Directories, links and other special members carry no source text.
+      PendingName.clear();
+      break;
+    }
+
+    Offset = DataOffset + llvm::alignTo(MemberSize, BlockSize);
+  }
+  return llvm::Error::success();
+}
+
+llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem>
+createArchiveFileSystem(const TarArchive &Archive, StringRef Root) {
+  auto FS = llvm::makeIntrusiveRefCnt<llvm::vfs::InMemoryFileSystem>();
+  for (const TarArchive::Member &Member : Archive.members()) {
+    llvm::SmallString<256> Path(Root);
+    llvm::sys::path::append(Path, Member.Name);
+    if (Member.IsNullTerminated)
+      FS->addFileNoOwn(Path, /*ModificationTime=*/0,
+                       llvm::MemoryBufferRef(Member.Data, Path));
+    else
+      FS->addFile(Path, /*ModificationTime=*/0,
+                  llvm::MemoryBuffer::getMemBufferCopy(Member.Data, Path));
+  }
+  return FS;
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
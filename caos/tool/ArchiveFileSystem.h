@@ -0,0 +1,65 @@
+//===--- ArchiveFileSystem.h - caos-batch -----------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_ARCHIVEFILESYSTEM_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_ARCHIVEFILESYSTEM_H
+
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+/// A read-only index of a ustar (POSIX/GNU tar) archive mapped into memory.
+///
+/// Member contents are never copied: \c Member::Data points into the mapping,
+/// which stays alive as long as the \c TarArchive object does.
+class TarArchive {
+public:
+  struct Member {
+    /// Path of the member inside the archive, without a leading "./".
+    std::string Name;
+    StringRef Data;
+    /// True if the byte right after \c Data is a NUL (tar block padding), so
+    /// the member can be handed to the lexer without a terminating copy.
+    bool IsNullTerminated;
+  };
+
+  static llvm::Expected<std::unique_ptr<TarArchive>> open(StringRef Path);
+
+  ArrayRef<Member> members() const { return Members; }
+
+private:
+  explicit TarArchive(llvm::sys::fs::mapped_file_region Region)
+      : Region(std::move(Region)) {}
+
+  llvm::Error index();
+
+  llvm::sys::fs::mapped_file_region Region;
+  std::vector<Member> Members;
+};
+
+/// Mounts every regular member of \p Archive under \p Root in a new in-memory
+/// file system. Members are added as non-owning buffers whenever the archive
+/// padding already provides the terminating NUL the lexer needs.
+llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem>
+createArchiveFileSystem(const TarArchive &Archive, StringRef Root);
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_ARCHIVEFILESYSTEM_H
@@ -0,0 +1,220 @@
+//===--- BatchScheduler.cpp - caos-batch ----------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "BatchScheduler.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <deque>
+#include <numeric>
+#include <tuple>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+static llvm::Error invalid(const llvm::Twine &Message) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(), Message);
+}
+
+llvm::Expected<ScheduleRules> ScheduleRules::parse(StringRef JSON,
+                                                   unsigned DefaultQuota) {
+  llvm::Expected<llvm::json::Value> Parsed = llvm::json::parse(JSON);
+  if (!Parsed)
+    return Parsed.takeError();
+  const llvm::json::Array *Array = Parsed->getAsArray();
+  if (!Array)
+    return invalid("schedule rules must be a list");
+
+  ScheduleRules Result(DefaultQuota);
+  for (const llvm::json::Value &Element : *Array) {
+    const llvm::json::Object *Object = Element.getAsObject();
+    std::optional<StringRef> Prefix =
+        Object ? Object->getString("prefix") : std::nullopt;
+    if (!Prefix)
+      return invalid("every schedule rule needs a \"prefix\"");
+
+    Rule R;
+    R.Prefix = Prefix->str();
+    if (std::optional<StringRef> Class = Object->getString("class")) {
+      R.Priority =
+          llvm::StringSwitch<std::optional<PriorityClass>>(*Class)
+              .Case("interactive", PriorityClass::Interactive)
+              .Case("normal", PriorityClass::Normal)
+              .Case("bulk", PriorityClass::Bulk)
+              .Default(std::nullopt);
+      if (!R.Priority)
+        return invalid("unknown priority class \"" + *Class + "\"");
+    }
+    R.Deadline = Object->getInteger("deadline");
+    if (std::optional<StringRef> Tenant = Object->getString("tenant"))
+      R.Tenant = Tenant->str();
+    if (std::optional<int64_t> Quota = Object->getInteger("quota")) {
+      if (*Quota < 0)
+        return invalid("\"quota\" must not be negative");
+      R.Quota = static_cast<unsigned>(*Quota);
+    }
+    Result.Rules.push_back(std::move(R));
+  }
+  return std::move(Result);
+}
+
+JobClass ScheduleRules::classify(StringRef MemberName) const {
+  JobClass Class;
+  Class.Tenant = MemberName.split('/').first.str();
+  Class.Quota = DefaultQuota;
+  const auto It = llvm::find_if(Rules, [MemberName](const Rule &R) {
+    return MemberName.startswith(R.Prefix);
+  });
+  if (It == Rules.end())
+    return Class;
+
+  Class.Priority = It->Priority.value_or(Class.Priority);
+  Class.Deadline = It->Deadline;
+  if (It->Tenant)
+    Class.Tenant = *It->Tenant;
+  Class.Quota = It->Quota.value_or(Class.Quota);
+  return Class;
+}
+
+llvm::Expected<TimingHistory> TimingHistory::load(StringRef Path) {
+  TimingHistory History;
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Buffer =
+      llvm::MemoryBuffer::getFile(Path);
+  if (!Buffer) {
+    if (Buffer.getError() == std::errc::no_such_file_or_directory)
+      return std::move(History);
+    return llvm::createFileError(Path, Buffer.getError());
+  }
+
+  // {"<member>": {"bytes": <size>, "ms": <wall time>}, ...}
+  llvm::Expected<llvm::json::Value> Parsed =
+      llvm::json::parse((*Buffer)->getBuffer());
+  if (!Parsed)
+    return llvm::createFileError(Path, Parsed.takeError());
+  const llvm::json::Object *Object = Parsed->getAsObject();
+  if (!Object)
+    return llvm::createFileError(Path, invalid("timings must be an object"));
+  for (const auto &[Name, Value] : *Object) {
+    const llvm::json::Object *Entry = Value.getAsObject();
+    std::optional<int64_t> Size =
+        Entry ? Entry->getInteger("bytes") : std::nullopt;
+    std::optional<double> Milliseconds =
+        Entry ? Entry->getNumber("ms") : std::nullopt;
+    if (Size && Milliseconds && *Size >= 0 && *Milliseconds >= 0)
+      History.record(Name, *Size, *Milliseconds);
+  }
+  return std::move(History);
+}
+
+double TimingHistory::estimate(StringRef Name, uint64_t Size) const {
+  auto It = Timings.find(Name);
+  if (It != Timings.end())
+    return It->second.Milliseconds;
+  if (TotalSize == 0)
+    return static_cast<double>(Size);
+  return Size * (TotalMilliseconds / TotalSize);
+}
+
+void TimingHistory::record(StringRef Name, uint64_t Size,
+                           double Milliseconds) {
+  auto [It, Inserted] = Timings.try_emplace(Name, Timing{Size, Milliseconds});
+  if (!Inserted) {
+    TotalSize -= It->second.Size;
+    TotalMilliseconds -= It->second.Milliseconds;
+    It->second = {Size, Milliseconds};
+  }
+  TotalSize += Size;
+  TotalMilliseconds += Milliseconds;
+}
+
+llvm::Error TimingHistory::save(StringRef Path) const {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC, llvm::sys::fs::OF_Text);
+  if (EC)
+    return llvm::createFileError(Path, EC);
+
+  llvm::json::Object Object;
+  for (const auto &Entry : Timings)
+    Object[Entry.first()] = llvm::json::Object{
+        {"bytes", static_cast<int64_t>(Entry.second.Size)},
+        {"ms", Entry.second.Milliseconds}};
+  {
+    llvm::json::OStream J(OS, /*IndentSize=*/2);
+    J.value(std::move(Object));
+  }
+  OS << "\n";
+
+  OS.close();
+  if (OS.has_error())
+    return llvm::createFileError(Path, OS.error());
+  return llvm::Error::success();
+}
+
+std::vector<size_t> scheduleJobs(ArrayRef<ScheduledJob> Jobs) {
+  auto Key = [&Jobs](size_t I) {
+    const ScheduledJob &Job = Jobs[I];
+    return std::make_tuple(Job.Class.Priority, !Job.Class.Deadline,
+                           Job.Class.Deadline.value_or(0), Job.Estimate, I);
+  };
+  auto Before = [&Key](size_t L, size_t R) { return Key(L) < Key(R); };
+
+  std::vector<size_t> Sorted(Jobs.size());
+  std::iota(Sorted.begin(), Sorted.end(), 0);
+  llvm::sort(Sorted, Before);
+
+  std::vector<size_t> Order;
+  Order.reserve(Jobs.size());
+  for (size_t Begin = 0, End; Begin < Sorted.size(); Begin = End) {
+    const PriorityClass Priority = Jobs[Sorted[Begin]].Class.Priority;
+    End = Begin;
+    // The jobs of the class, per tenant, each tenant's in order.
+    llvm::MapVector<StringRef, std::deque<size_t>> Queues;
+    for (; End < Sorted.size() && Jobs[Sorted[End]].Class.Priority == Priority;
+         ++End)
+      Queues[Jobs[Sorted[End]].Class.Tenant].push_back(Sorted[End]);
+
+    StringRef Last;
+    unsigned Streak = 0;
+    for (size_t N = Begin; N < End; ++N) {
+      // The tenant whose next job comes first, unless it is the one that has
+      // just used up its quota; it goes on only if nobody else is waiting.
+      std::deque<size_t> *Next = nullptr;
+      std::deque<size_t> *Yielding = nullptr;
+      for (auto &[Tenant, Queue] : Queues) {
+        if (Queue.empty())
+          continue;
+        const unsigned Quota = Jobs[Queue.front()].Class.Quota;
+        if (Tenant == Last && Quota != 0 && Streak >= Quota) {
+          Yielding = &Queue;
+          continue;
+        }
+        if (!Next || Before(Queue.front(), Next->front()))
+          Next = &Queue;
+      }
+      if (!Next)
+        Next = Yielding;
+
+      const size_t Job = Next->front();
+      Next->pop_front();
+      Order.push_back(Job);
+      const StringRef Tenant = Jobs[Job].Class.Tenant;
+      Streak = Tenant == Last ? Streak + 1 : 1;
+      Last = Tenant;
+    }
+  }
+  return Order;
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
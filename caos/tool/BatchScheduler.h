@@ -0,0 +1,114 @@
+//===--- BatchScheduler.h - caos-batch --------------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_BATCHSCHEDULER_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_BATCHSCHEDULER_H
+
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+/// Priority classes of the jobs of a batch, most urgent first.
+enum class PriorityClass { Interactive, Normal, Bulk };
+
+/// How the members of an archive are scheduled.
+struct JobClass {
+  PriorityClass Priority = PriorityClass::Normal;
+  /// Seconds since the epoch; unset for no deadline.
+  std::optional<int64_t> Deadline;
+  std::string Tenant;
+  /// How many jobs of the tenant may run in a row while other tenants of the
+  /// same priority class wait. 0 means no limit.
+  unsigned Quota = 0;
+};
+
+/// Rules assigning a \c JobClass to the members of an archive, read from a
+/// JSON list such as
+/// \code
+///   [{"prefix": "cs101/alice/", "class": "interactive",
+///     "deadline": 1760824740, "tenant": "cs101", "quota": 4}]
+/// \endcode
+/// The first rule whose prefix starts the member name applies; every field
+/// but the prefix is optional. The tenant defaults to the first component of
+/// the member name, and the class to "normal".
+class ScheduleRules {
+public:
+  explicit ScheduleRules(unsigned DefaultQuota = 0)
+      : DefaultQuota(DefaultQuota) {}
+
+  static llvm::Expected<ScheduleRules> parse(StringRef JSON,
+                                             unsigned DefaultQuota);
+
+  JobClass classify(StringRef MemberName) const;
+
+private:
+  struct Rule {
+    std::string Prefix;
+    std::optional<PriorityClass> Priority;
+    std::optional<int64_t> Deadline;
+    std::optional<std::string> Tenant;
+    std::optional<unsigned> Quota;
+  };
+
+  std::vector<Rule> Rules;
+  unsigned DefaultQuota;
+};
+
+/// Wall times of the members analysed by earlier batches, to estimate how
+/// long a job will take. A member without history is estimated from its size,
+/// at the average rate of the history.
+class TimingHistory {
+public:
+  /// Reads the history written by \c save(); a missing file is an empty
+  /// history.
+  static llvm::Expected<TimingHistory> load(StringRef Path);
+
+  /// Estimated milliseconds (or, without any history, bytes) to analyse
+  /// \p Name, of \p Size bytes.
+  double estimate(StringRef Name, uint64_t Size) const;
+
+  void record(StringRef Name, uint64_t Size, double Milliseconds);
+
+  llvm::Error save(StringRef Path) const;
+
+private:
+  struct Timing {
+    uint64_t Size;
+    double Milliseconds;
+  };
+
+  llvm::StringMap<Timing> Timings;
+  uint64_t TotalSize = 0;
+  double TotalMilliseconds = 0;
+};
+
+/// A job to schedule: a group of members analysed together.
+struct ScheduledJob {
+  JobClass Class;
+  double Estimate;
+};
+
+/// Returns the order to run \p Jobs in, as indices: by priority class, then
+/// earliest deadline first (jobs without one last), then shortest estimate
+/// first, then in the given order; except that a tenant which has run its
+/// quota of jobs in a row yields to the other tenants of the class.
+std::vector<size_t> scheduleJobs(ArrayRef<ScheduledJob> Jobs);
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_BATCHSCHEDULER_H
@@ -0,0 +1,215 @@
+//===--- BinaryDiagnostics.cpp - caos-batch -------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "BinaryDiagnostics.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/LEB128.h"
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+static constexpr llvm::StringLiteral ChunkTag = "CDG2";
+
+namespace {
+
+/// The string table of a chunk being written.
+class StringTable {
+public:
+  unsigned add(StringRef S) {
+    auto [It, Inserted] = Indices.try_emplace(S, Strings.size());
+    if (Inserted)
+      Strings.push_back(S);
+    return It->second;
+  }
+
+  ArrayRef<StringRef> strings() const { return Strings; }
+
+private:
+  llvm::DenseMap<StringRef, unsigned> Indices;
+  std::vector<StringRef> Strings;
+};
+
+/// Reads the numbers and strings of a chunk, failing on the first one that
+/// runs past its end.
+class ChunkReader {
+public:
+  explicit ChunkReader(StringRef Data) : Data(Data) {}
+
+  bool failed() const { return Failed; }
+  bool atEnd() const { return Data.empty(); }
+
+  uint64_t readNumber() {
+    if (Failed)
+      return 0;
+    unsigned Size = 0;
+    const char *Error = nullptr;
+    const uint64_t Value = llvm::decodeULEB128(
+        reinterpret_cast<const uint8_t *>(Data.data()), &Size,
+        reinterpret_cast<const uint8_t *>(Data.end()), &Error);
+    if (Error) {
+      Failed = true;
+      return 0;
+    }
+    Data = Data.drop_front(Size);
+    return Value;
+  }
+
+  StringRef readBytes(uint64_t Size) {
+    if (Failed || Size > Data.size()) {
+      Failed = true;
+      return {};
+    }
+    StringRef Bytes = Data.take_front(Size);
+    Data = Data.drop_front(Size);
+    return Bytes;
+  }
+
+  StringRef readString(ArrayRef<StringRef> Strings) {
+    const uint64_t Index = readNumber();
+    if (Failed || Index >= Strings.size()) {
+      Failed = true;
+      return {};
+    }
+    return Strings[Index];
+  }
+
+private:
+  StringRef Data;
+  bool Failed = false;
+};
+
+} // namespace
+
+void writeBinaryUnit(llvm::raw_ostream &OS, const BinaryUnit &Unit) {
+  // The body refers to the strings by index, so it is encoded first.
+  StringTable Strings;
+  llvm::SmallString<256> Body;
+  llvm::raw_svector_ostream B(Body);
+  llvm::encodeULEB128(Strings.add(Unit.Name), B);
+  llvm::encodeULEB128(Unit.Diagnostics.size(), B);
+  for (const BinaryDiagnostic &D : Unit.Diagnostics) {
+    llvm::encodeULEB128(Strings.add(D.Check), B);
+    llvm::encodeULEB128(static_cast<uint8_t>(D.Level), B);
+    llvm::encodeULEB128(Strings.add(D.File), B);
+    llvm::encodeULEB128(D.Offset, B);
+    llvm::encodeULEB128(D.Line, B);
+    llvm::encodeULEB128(D.Column, B);
+    llvm::encodeULEB128(Strings.add(D.Message), B);
+    llvm::encodeULEB128(D.Fixes.size(), B);
+    for (const BinaryReplacement &R : D.Fixes) {
+      llvm::encodeULEB128(Strings.add(R.File), B);
+      llvm::encodeULEB128(R.Offset, B);
+      llvm::encodeULEB128(R.Length, B);
+      llvm::encodeULEB128(Strings.add(R.Text), B);
+    }
+    llvm::encodeULEB128(D.Notes.size(), B);
+    for (const BinaryNote &N : D.Notes) {
+      llvm::encodeULEB128(Strings.add(N.File), B);
+      llvm::encodeULEB128(N.Offset, B);
+      llvm::encodeULEB128(N.Line, B);
+      llvm::encodeULEB128(N.Column, B);
+      llvm::encodeULEB128(Strings.add(N.Message), B);
+    }
+  }
+
+  llvm::SmallString<256> Table;
+  llvm::raw_svector_ostream T(Table);
+  llvm::encodeULEB128(Strings.strings().size(), T);
+  for (StringRef S : Strings.strings()) {
+    llvm::encodeULEB128(S.size(), T);
+    T << S;
+  }
+
+  OS << ChunkTag;
+  llvm::encodeULEB128(Table.size() + Body.size(), OS);
+  OS << Table << Body;
+}
+
+static llvm::Error malformed(size_t Offset) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 "malformed diagnostics at offset %zu",
+                                 Offset);
+}
+
+llvm::Error
+readBinaryUnits(StringRef Data,
+                llvm::function_ref<void(const BinaryUnit &)> Callback) {
+  std::vector<StringRef> Strings;
+  BinaryUnit Unit;
+  for (size_t Offset = 0; Offset < Data.size();) {
+    ChunkReader Header(Data.drop_front(Offset));
+    if (Header.readBytes(ChunkTag.size()) != ChunkTag)
+      return malformed(Offset);
+    const uint64_t Size = Header.readNumber();
+    const StringRef Chunk = Header.readBytes(Size);
+    if (Header.failed())
+      return malformed(Offset);
+
+    ChunkReader R(Chunk);
+    // Every string takes at least a byte, which bounds the count before
+    // anything is allocated for it.
+    const uint64_t NumStrings = R.readNumber();
+    if (R.failed() || NumStrings > Chunk.size())
+      return malformed(Offset);
+    Strings.clear();
+    Strings.reserve(NumStrings);
+    for (uint64_t I = 0; I < NumStrings; ++I)
+      Strings.push_back(R.readBytes(R.readNumber()));
+
+    Unit.Name = R.readString(Strings);
+    const uint64_t NumDiagnostics = R.readNumber();
+    if (R.failed() || NumDiagnostics > Chunk.size())
+      return malformed(Offset);
+    Unit.Diagnostics.resize(NumDiagnostics);
+    for (BinaryDiagnostic &D : Unit.Diagnostics) {
+      D.Check = R.readString(Strings);
+      const uint64_t Level = R.readNumber();
+      if (Level > static_cast<uint8_t>(BinaryLevel::Remark))
+        return malformed(Offset);
+      D.Level = static_cast<BinaryLevel>(Level);
+      D.File = R.readString(Strings);
+      D.Offset = R.readNumber();
+      D.Line = R.readNumber();
+      D.Column = R.readNumber();
+      D.Message = R.readString(Strings);
+      const uint64_t NumFixes = R.readNumber();
+      if (R.failed() || NumFixes > Chunk.size())
+        return malformed(Offset);
+      D.Fixes.resize(NumFixes);
+      for (BinaryReplacement &Fix : D.Fixes) {
+        Fix.File = R.readString(Strings);
+        Fix.Offset = R.readNumber();
+        Fix.Length = R.readNumber();
+        Fix.Text = R.readString(Strings);
+      }
+      const uint64_t NumNotes = R.readNumber();
+      if (R.failed() || NumNotes > Chunk.size())
+        return malformed(Offset);
+      D.Notes.resize(NumNotes);
+      for (BinaryNote &Note : D.Notes) {
+        Note.File = R.readString(Strings);
+        Note.Offset = R.readNumber();
+        Note.Line = R.readNumber();
+        Note.Column = R.readNumber();
+        Note.Message = R.readString(Strings);
+      }
+    }
+    if (R.failed() || !R.atEnd())
+      return malformed(Offset);
+
+    Callback(Unit);
+    Offset = Chunk.end() - Data.begin();
+  }
+  return llvm::Error::success();
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
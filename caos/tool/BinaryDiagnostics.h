@@ -0,0 +1,93 @@
+//===--- BinaryDiagnostics.h - caos-batch -----------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_BINARYDIAGNOSTICS_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_BINARYDIAGNOSTICS_H
+
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <vector>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+/// The findings of a batch in a compact binary form, written by caos-batch
+/// --format=binary and converted by caos-results.
+///
+/// A file is a sequence of chunks, one per unit, so that the outputs of
+/// several writers can simply be concatenated. A chunk is
+/// \code
+///   "CDG2" <size of the rest of the chunk>
+///   <string count> (<length> <bytes>)...
+///   <unit> <diagnostic count> <diagnostic>...
+/// \endcode
+/// and a diagnostic
+/// \code
+///   <check> <level> <file> <offset> <line> <column> <message>
+///   <replacement count> (<file> <offset> <length> <text>)...
+///   <note count> (<file> <offset> <line> <column> <message>)...
+/// \endcode
+/// where every number is an unsigned LEB128 and every string an index into
+/// the string table of the chunk, which holds each distinct string once. An
+/// empty file name means the diagnostic or note has no location.
+///
+/// Reading maps the file and points into it, without copying any string.
+
+enum class BinaryLevel : uint8_t { Warning, Error, Remark };
+
+struct BinaryReplacement {
+  StringRef File;
+  uint64_t Offset;
+  uint64_t Length;
+  StringRef Text;
+};
+
+struct BinaryNote {
+  StringRef File;
+  uint64_t Offset;
+  unsigned Line;
+  unsigned Column;
+  StringRef Message;
+};
+
+struct BinaryDiagnostic {
+  StringRef Check;
+  BinaryLevel Level;
+  StringRef File;
+  uint64_t Offset;
+  unsigned Line;
+  unsigned Column;
+  StringRef Message;
+  std::vector<BinaryReplacement> Fixes;
+  std::vector<BinaryNote> Notes;
+};
+
+struct BinaryUnit {
+  StringRef Name;
+  std::vector<BinaryDiagnostic> Diagnostics;
+};
+
+/// Appends the chunk of \p Unit to \p OS.
+void writeBinaryUnit(llvm::raw_ostream &OS, const BinaryUnit &Unit);
+
+/// Calls \p Callback on each unit of \p Data, in order. The strings of a unit
+/// point into \p Data.
+llvm::Error
+readBinaryUnits(StringRef Data,
+                llvm::function_ref<void(const BinaryUnit &)> Callback);
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_BINARYDIAGNOSTICS_H
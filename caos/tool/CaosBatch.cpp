@@ -0,0 +1,898 @@
+//===--- CaosBatch.cpp - caos-batch ---------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Runs the CAOS checks over every source file of a submission archive without
+// extracting it: the archive is mapped into memory and served to clang-tidy
+// through an in-memory file system overlay. Findings are streamed to the output
+// (as text, JSON Lines or binary) as soon as each member has been analysed,
+// keyed by the member name. Members compiled with the same flags can be
+// analysed in groups that share one clang tool run, and so its file manager.
+// The system headers can be served from a snapshot recorded by an earlier
+// batch, the groups analysed by worker processes, and the findings appended
+// to a results store for caos-query.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../../clang-tidy/ClangTidy.h"
+#include "../../clang-tidy/ClangTidyOptions.h"
+#include "../CheckStatistics.h"
+#include "ArchiveFileSystem.h"
+#include "BatchScheduler.h"
+#include "DiagnosticSink.h"
+#include "HeaderSnapshot.h"
+#include "ResultStore.h"
+#include "ShardCoordinator.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+#include <optional>
+
+using namespace llvm;
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+static cl::OptionCategory CaosBatchCategory("caos-batch options");
+
+static cl::opt<std::string> ArchivePath(cl::Positional, cl::Required,
+                                        cl::desc("<submissions.tar>"),
+                                        cl::cat(CaosBatchCategory));
+
+static cl::opt<std::string> Checks("checks", cl::desc(R"(
+Comma-separated list of globs with optional '-'
+prefix, applied on top of the configuration found
+in the archive. Defaults to all CAOS checks.
+)"),
+                                   cl::init(""), cl::cat(CaosBatchCategory));
+
+static cl::opt<std::string> Config("config", cl::desc(R"(
+Configuration in YAML/JSON format, as accepted by
+clang-tidy's -config option.
+)"),
+                                   cl::init(""), cl::cat(CaosBatchCategory));
+
+static cl::opt<std::string> Extensions("extensions", cl::desc(R"(
+Comma-separated list of file extensions of the
+archive members that are analysed as translation
+units. Other members (e.g. headers) are only made
+available to #include.
+)"),
+                                       cl::init("c"),
+                                       cl::cat(CaosBatchCategory));
+
+static cl::opt<std::string> MountPoint("mount-point", cl::desc(R"(
+Virtual directory the archive is mounted at.
+)"),
+                                       cl::init("/caos-archive"),
+                                       cl::cat(CaosBatchCategory));
+
+static cl::opt<std::string> BuildPath("p", cl::desc(R"(
+Build directory containing a compile_commands.json
+to take the flags of each member from, instead of
+the flags after "--". Its entries name the members
+by their path under -mount-point; mount the archive
+where the database was generated.
+)"),
+                                      cl::init(""),
+                                      cl::cat(CaosBatchCategory));
+
+static cl::opt<unsigned> GroupSize("group-size", cl::desc(R"(
+Maximum number of members with the same compile
+flags analysed by one clang tool run. The members
+of a group share its file manager (stat cache and
+file entries) and the reading of their common
+headers; their findings are reported when the whole
+group is done, those in a header under every member
+that read it, even if the member's macros compile
+the finding out. Defaults to 1, one member at a time.
+)"),
+                                    cl::init(1), cl::cat(CaosBatchCategory));
+
+static cl::opt<std::string> SystemHeaderSnapshot("system-header-snapshot",
+                                                 cl::desc(R"(
+Snapshot of the system headers read by the batch.
+If the file exists, the headers, and the lookups
+of the ones that don't exist, are served from it
+instead of the file system; otherwise the lookups
+of this run are recorded and the snapshot written
+when it is done. Delete it after the system
+headers change.
+)"),
+                                                 cl::init(""),
+                                                 cl::cat(CaosBatchCategory));
+
+static cl::opt<std::string> SystemHeaderDirs("system-header-dirs", cl::desc(R"(
+Comma-separated list of the directories recorded
+in a new -system-header-snapshot.
+)"),
+    cl::init("/usr/include,/usr/local/include,/usr/lib/gcc,"
+             "/usr/lib/llvm-17/lib/clang"),
+    cl::cat(CaosBatchCategory));
+
+static cl::opt<std::string> LineFilter("line-filter", cl::desc(R"(
+Lines to report findings on, as for clang-tidy:
+a JSON list of {"name":file,"lines":[[first,last]]}.
+The checks skip the names and literals on other
+lines. File names are matched against the end of
+the paths under the mount point.
+)"),
+                                       cl::init(""),
+                                       cl::cat(CaosBatchCategory));
+
+static cl::opt<std::string> DiffFile("diff", cl::desc(R"(
+Unified diff of the members against a baseline
+(e.g. the previous submission): only the lines it
+adds are checked and reported, context lines left
+out. Members the diff doesn't touch are still
+parsed but not checked.
+)"),
+                                     cl::init(""), cl::cat(CaosBatchCategory));
+
+static cl::opt<unsigned> DiffStrip("diff-strip", cl::desc(R"(
+Number of leading components stripped from the
+file names of -diff, as for patch -p. Defaults to
+1, for the a/ and b/ prefixes of git diff.
+)"),
+                                   cl::init(1), cl::cat(CaosBatchCategory));
+
+static cl::opt<unsigned> Workers("workers", cl::desc(R"(
+Number of worker processes analysing the groups.
+The process started becomes their coordinator: it
+hands the groups out one at a time to whichever
+worker is free, replaces the workers that crash,
+and writes the findings in the same order as a
+single process would. Defaults to 1, no workers.
+)"),
+                                 cl::init(1), cl::cat(CaosBatchCategory));
+
+static cl::opt<unsigned> WorkerRetries("worker-retries", cl::desc(R"(
+Number of times a group is handed out again after
+the worker analysing it crashed, before its units
+are reported as failed. Defaults to 1.
+)"),
+                                       cl::init(1),
+                                       cl::cat(CaosBatchCategory));
+
+static cl::opt<std::string> ScheduleFile("schedule", cl::desc(R"(
+JSON list of rules giving members a priority
+class, a deadline and a tenant, e.g.
+  [{"prefix": "cs101/alice/",
+    "class": "interactive",
+    "deadline": 1760824740, "tenant": "cs101"}]
+Groups of members then run by class (interactive,
+normal, bulk), earliest deadline first, shortest
+estimated first. See -tenant-quota and -timings.
+)"),
+                                         cl::init(""),
+                                         cl::cat(CaosBatchCategory));
+
+static cl::opt<unsigned> TenantQuota("tenant-quota", cl::desc(R"(
+Number of groups of one tenant (by default the
+first component of the member name) that may run
+in a row while other tenants of the same priority
+class wait. A "quota" in a -schedule rule
+overrides it. Defaults to 0, no limit.
+)"),
+                                     cl::init(0), cl::cat(CaosBatchCategory));
+
+static cl::opt<std::string> TimingsFile("timings", cl::desc(R"(
+File of the wall times of the members analysed by
+earlier batches, read to estimate the length of
+the groups for -schedule and updated with the
+times of this batch. Members without history are
+estimated from their size.
+)"),
+                                        cl::init(""),
+                                        cl::cat(CaosBatchCategory));
+
+enum class OutputFormat { Text, JSONLines, Binary };
+
+static cl::opt<OutputFormat> Format(
+    "format", cl::desc("Output format of the findings."),
+    cl::values(clEnumValN(OutputFormat::Text, "text",
+                          "compiler-style diagnostics (default)"),
+               clEnumValN(OutputFormat::JSONLines, "jsonl",
+                          "one JSON object per finding"),
+               clEnumValN(OutputFormat::Binary, "binary",
+                          "compact binary, read by caos-results")),
+    cl::init(OutputFormat::Text), cl::cat(CaosBatchCategory));
+
+static cl::opt<std::string> OutputFile("output", cl::desc(R"(
+File to write the findings to. Defaults to stdout.
+)"),
+                                       cl::init("-"),
+                                       cl::cat(CaosBatchCategory));
+
+static cl::opt<int> OutputFD("output-fd", cl::desc(R"(
+Already open file descriptor to write the findings
+to, instead of -output.
+)"),
+                             cl::init(-1), cl::cat(CaosBatchCategory));
+
+static cl::opt<std::string> StorePath("store", cl::desc(R"(
+Directory of a results store to append the
+findings to, for caos-query. Created if needed.
+)"),
+                                      cl::init(""),
+                                      cl::cat(CaosBatchCategory));
+
+static cl::opt<std::string> Submission("submission", cl::desc(R"(
+What the findings are stored under in -store, e.g.
+the assignment. Defaults to the archive name
+without its extension.
+)"),
+                                       cl::init(""),
+                                       cl::cat(CaosBatchCategory));
+
+namespace {
+
+/// A translation unit to analyse: an archive member.
+struct Unit {
+  std::string Name;
+  std::string Path;
+  uint64_t Size;
+};
+
+/// Records the files each member of a group reads while the group is
+/// analysed by one run, main file and headers alike.
+///
+/// clang-tidy reports a finding in a header once for the whole run, while
+/// the members analysed one by one would each report it. The findings of a
+/// group are attributed to every member that read their file. The run only
+/// keeps one copy of each finding, so which members' own analysis produced it
+/// is lost: a member whose macros compile the offending region out still gets
+/// it.
+class ReadTracker : public vfs::ProxyFileSystem {
+public:
+  explicit ReadTracker(IntrusiveRefCntPtr<vfs::FileSystem> FS)
+      : ProxyFileSystem(std::move(FS)) {}
+
+  ErrorOr<std::unique_ptr<vfs::File>>
+  openFileForRead(const Twine &Path) override {
+    ErrorOr<std::unique_ptr<vfs::File>> File =
+        ProxyFileSystem::openFileForRead(Path);
+    if (File && Current)
+      Current->insert(normalize(Path));
+    return File;
+  }
+
+  /// Attributes the files read from now on to the member at \p Path.
+  void startMember(StringRef Path) { Current = &Reads[normalize(Path)]; }
+
+  /// Whether the member at \p Path read \p File.
+  bool hasRead(StringRef Path, StringRef File) const {
+    const std::string Member = normalize(Path);
+    const std::string Normalized = normalize(File);
+    auto It = Reads.find(Member);
+    return Member == Normalized ||
+           (It != Reads.end() && It->second.contains(Normalized));
+  }
+
+  void clear() {
+    Reads.clear();
+    Current = nullptr;
+  }
+
+private:
+  std::string normalize(const Twine &Path) const {
+    SmallString<256> P;
+    Path.toVector(P);
+    makeAbsolute(P);
+    sys::path::remove_dots(P, /*remove_dot_dot=*/true);
+    return std::string(P);
+  }
+
+  StringMap<StringSet<>> Reads;
+  StringSet<> *Current = nullptr;
+};
+
+/// Passes the commands of a compilation database through. ClangTool asks for
+/// the commands of each member right before parsing it, which tells the
+/// \c ReadTracker whose reads follow.
+class TrackingCompilationDatabase : public tooling::CompilationDatabase {
+public:
+  TrackingCompilationDatabase(const tooling::CompilationDatabase &Base,
+                              ReadTracker &Tracker)
+      : Base(Base), Tracker(Tracker) {}
+
+  std::vector<tooling::CompileCommand>
+  getCompileCommands(StringRef FilePath) const override {
+    Tracker.startMember(FilePath);
+    return Base.getCompileCommands(FilePath);
+  }
+  std::vector<std::string> getAllFiles() const override {
+    return Base.getAllFiles();
+  }
+  std::vector<tooling::CompileCommand> getAllCompileCommands() const override {
+    return Base.getAllCompileCommands();
+  }
+
+private:
+  const tooling::CompilationDatabase &Base;
+  ReadTracker &Tracker;
+};
+
+} // namespace
+
+// The flags of Command that affect parsing, for grouping the translation units
+// built the same way: the working directory and the arguments, without the
+// source file, -c, and the output and dependency files.
+static std::string getFlagsKey(const tooling::CompileCommand &Command) {
+  std::string Key = Command.Directory;
+  const std::vector<std::string> &Args = Command.CommandLine;
+  for (size_t I = 0; I < Args.size(); ++I) {
+    StringRef Arg = Args[I];
+    if (Arg == "-o" || Arg == "-MF" || Arg == "-MT" || Arg == "-MQ") {
+      ++I;
+      continue;
+    }
+    if (Arg == "-c" || Arg == "-MD" || Arg == "-MMD")
+      continue;
+    SmallString<256> AbsoluteArg(Arg);
+    if (!sys::path::is_absolute(AbsoluteArg))
+      sys::path::make_absolute(Command.Directory, AbsoluteArg);
+    if (Arg == Command.Filename || AbsoluteArg == Command.Filename)
+      continue;
+    Key += '\0';
+    Key += Arg;
+  }
+  return Key;
+}
+
+// Splits Units into groups of at most MaxSize with the same flags, keeping the
+// archive order within and across groups.
+static std::vector<std::vector<Unit>>
+groupByFlags(std::vector<Unit> Units,
+             const tooling::CompilationDatabase &Compilations,
+             unsigned MaxSize) {
+  llvm::MapVector<std::string, std::vector<Unit>> ByFlags;
+  for (Unit &U : Units) {
+    std::vector<tooling::CompileCommand> Commands =
+        Compilations.getCompileCommands(U.Path);
+    // Members without a command fail alone, as they would ungrouped.
+    std::string Key = Commands.empty() ? std::string("\0", 1) + U.Path
+                                       : getFlagsKey(Commands.front());
+    ByFlags[Key].push_back(std::move(U));
+  }
+
+  std::vector<std::vector<Unit>> Groups;
+  for (auto &[Key, Members] : ByFlags)
+    for (size_t Begin = 0; Begin < Members.size(); Begin += MaxSize)
+      Groups.emplace_back(
+          std::make_move_iterator(Members.begin() + Begin),
+          std::make_move_iterator(
+              Members.begin() + std::min<size_t>(Members.size(),
+                                                 Begin + MaxSize)));
+  return Groups;
+}
+
+static double
+getMillisecondsSince(std::chrono::steady_clock::time_point Start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - Start)
+      .count();
+}
+
+// Reorders Groups as scheduleJobs decides. A group is as urgent as its most
+// urgent member, belongs to the tenant of its first one, and takes as long as
+// all of them.
+static std::vector<std::vector<Unit>>
+scheduleGroups(std::vector<std::vector<Unit>> Groups,
+               const ScheduleRules &Rules, const TimingHistory &Timings) {
+  std::vector<ScheduledJob> Jobs;
+  Jobs.reserve(Groups.size());
+  for (const std::vector<Unit> &Group : Groups) {
+    ScheduledJob Job{Rules.classify(Group.front().Name), 0};
+    for (const Unit &U : Group) {
+      const JobClass Class = Rules.classify(U.Name);
+      Job.Class.Priority = std::min(Job.Class.Priority, Class.Priority);
+      if (Class.Deadline &&
+          (!Job.Class.Deadline || *Class.Deadline < *Job.Class.Deadline))
+        Job.Class.Deadline = Class.Deadline;
+      Job.Estimate += Timings.estimate(U.Name, U.Size);
+    }
+    Jobs.push_back(std::move(Job));
+  }
+
+  std::vector<std::vector<Unit>> Scheduled;
+  Scheduled.reserve(Groups.size());
+  for (size_t I : scheduleJobs(Jobs))
+    Scheduled.push_back(std::move(Groups[I]));
+  return Scheduled;
+}
+
+// Parses a hunk range, "<first>[,<count>]", whose count defaults to 1.
+static bool parseHunkRange(StringRef Range, unsigned &First, unsigned &Count) {
+  const auto [FirstStr, CountStr] = Range.split(',');
+  Count = 1;
+  return !FirstStr.getAsInteger(10, First) &&
+         (CountStr.empty() || !CountStr.getAsInteger(10, Count));
+}
+
+// Appends to Filter the lines added by the unified diff Diff to the new
+// version of each file it changes. Unlike clang-tidy-diff.py, which keeps the
+// whole new range of every hunk, context lines are left out: they did not
+// change. File names are stripped of Strip components and looked up under
+// MountPoint.
+static void parseUnifiedDiff(StringRef Diff, unsigned Strip,
+                             StringRef MountPoint,
+                             std::vector<FileFilter> &Filter) {
+  const size_t FirstChanged = Filter.size();
+  std::optional<size_t> Current;
+  bool AfterOldName = false;
+  // The lines of the current hunk still to come on each side, and the number
+  // in the new version of the next one.
+  unsigned OldLeft = 0, NewLeft = 0, NewLine = 0;
+  SmallVector<StringRef, 0> Lines;
+  Diff.split(Lines, '\n');
+  for (StringRef Line : Lines) {
+    Line.consume_back("\r");
+    if (OldLeft != 0 || NewLeft != 0) {
+      if (Line.empty() || Line.front() == ' ') {
+        // Some tools strip the space of an empty context line.
+        if (OldLeft != 0)
+          --OldLeft;
+        if (NewLeft != 0)
+          --NewLeft;
+        ++NewLine;
+        continue;
+      }
+      if (Line.front() == '-' && OldLeft != 0) {
+        --OldLeft;
+        continue;
+      }
+      if (Line.front() == '+' && NewLeft != 0) {
+        --NewLeft;
+        if (Current) {
+          std::vector<FileFilter::LineRange> &Ranges =
+              Filter[*Current].LineRanges;
+          if (!Ranges.empty() && Ranges.back().second + 1 == NewLine)
+            Ranges.back().second = NewLine;
+          else
+            Ranges.emplace_back(NewLine, NewLine);
+        }
+        ++NewLine;
+        continue;
+      }
+      // "\ No newline at end of file" belongs to the hunk; anything else
+      // means that it was cut short.
+      if (Line.front() == '\\')
+        continue;
+      OldLeft = NewLeft = 0;
+    }
+
+    // Between hunks, the "+++" name line follows a "---" one.
+    const bool IsNewName = AfterOldName && Line.consume_front("+++ ");
+    AfterOldName = Line.startswith("--- ");
+    if (IsNewName) {
+      Current.reset();
+      // The name may be followed by a tab and a timestamp.
+      StringRef Name = Line.take_until([](char C) { return C == '\t'; });
+      Name = Name.trim('"');
+      if (Name == "/dev/null")
+        continue;
+      for (unsigned I = 0; I < Strip && !Name.empty(); ++I)
+        Name = Name.split('/').second;
+      if (Name.empty())
+        continue;
+      SmallString<256> Path(MountPoint);
+      sys::path::append(Path, Name);
+      Current = Filter.size();
+      Filter.push_back({std::string(Path), {}});
+      continue;
+    }
+
+    // "@@ -<old first>[,<old count>] +<new first>[,<new count>] @@". The
+    // hunks of a deleted file are walked too, to skip their lines.
+    if (!Line.consume_front("@@ -"))
+      continue;
+    const auto [OldRange, Rest] = Line.split(" +");
+    const StringRef NewRange = Rest.take_until([](char C) { return C == ' '; });
+    unsigned OldFirst, OldCount, NewFirst, NewCount;
+    if (!parseHunkRange(OldRange, OldFirst, OldCount) ||
+        !parseHunkRange(NewRange, NewFirst, NewCount))
+      continue;
+    OldLeft = OldCount;
+    NewLeft = NewCount;
+    NewLine = NewFirst;
+  }
+
+  // A file with nothing added has no lines to check, but a filter entry
+  // without ranges would keep all of them.
+  Filter.erase(std::remove_if(Filter.begin() + FirstChanged, Filter.end(),
+                              [](const FileFilter &Entry) {
+                                return Entry.LineRanges.empty();
+                              }),
+               Filter.end());
+}
+
+static int caosBatchMain(int Argc, const char **Argv) {
+  InitLLVM X(Argc, Argv);
+
+  SmallString<256> WorkingDirectory;
+  if (std::error_code EC = sys::fs::current_path(WorkingDirectory)) {
+    errs() << "caos-batch: cannot get working directory: " << EC.message()
+           << "\n";
+    return 1;
+  }
+
+  // Compiler flags for every member are passed after "--".
+  std::string ErrorMessage;
+  std::unique_ptr<tooling::CompilationDatabase> Compilations =
+      tooling::FixedCompilationDatabase::loadFromCommandLine(
+          Argc, Argv, ErrorMessage, WorkingDirectory);
+  if (!ErrorMessage.empty()) {
+    errs() << "caos-batch: " << ErrorMessage << "\n";
+    return 1;
+  }
+  if (!Compilations)
+    Compilations = std::make_unique<tooling::FixedCompilationDatabase>(
+        WorkingDirectory, std::vector<std::string>());
+
+  cl::HideUnrelatedOptions(CaosBatchCategory);
+  cl::ParseCommandLineOptions(
+      Argc, Argv,
+      "Runs the CAOS clang-tidy checks over the members of a tar archive.\n");
+
+  if (!BuildPath.empty()) {
+    Compilations = tooling::CompilationDatabase::loadFromDirectory(
+        BuildPath, ErrorMessage);
+    if (!Compilations) {
+      errs() << "caos-batch: " << ErrorMessage << "\n";
+      return 1;
+    }
+  }
+  if (GroupSize == 0) {
+    errs() << "caos-batch: -group-size must be at least 1\n";
+    return 1;
+  }
+
+  llvm::Expected<std::unique_ptr<TarArchive>> Archive =
+      TarArchive::open(ArchivePath);
+  if (!Archive) {
+    errs() << "caos-batch: " << toString(Archive.takeError()) << "\n";
+    return 1;
+  }
+
+  // The system headers are served from a snapshot, if there is one, under
+  // the archive.
+  IntrusiveRefCntPtr<vfs::FileSystem> SystemFS = vfs::getRealFileSystem();
+  std::unique_ptr<HeaderSnapshot> Snapshot;
+  IntrusiveRefCntPtr<HeaderSnapshotRecorder> Recorder;
+  if (!SystemHeaderSnapshot.empty()) {
+    if (sys::fs::exists(SystemHeaderSnapshot)) {
+      llvm::Expected<std::unique_ptr<HeaderSnapshot>> Opened =
+          HeaderSnapshot::open(SystemHeaderSnapshot);
+      if (!Opened) {
+        errs() << "caos-batch: " << toString(Opened.takeError()) << "\n";
+        return 1;
+      }
+      Snapshot = std::move(*Opened);
+      SystemFS = createSnapshotFileSystem(*Snapshot, std::move(SystemFS));
+    } else {
+      SmallVector<StringRef, 4> Dirs;
+      SplitString(SystemHeaderDirs, Dirs, ",");
+      Recorder = makeIntrusiveRefCnt<HeaderSnapshotRecorder>(
+          std::move(SystemFS),
+          std::vector<std::string>(Dirs.begin(), Dirs.end()));
+      SystemFS = Recorder;
+    }
+  }
+
+  auto BaseFS = makeIntrusiveRefCnt<vfs::OverlayFileSystem>(SystemFS);
+  BaseFS->pushOverlay(createArchiveFileSystem(**Archive, MountPoint));
+  // The members of a group are analysed through the tracker, which tells
+  // which of them read the file of each finding.
+  IntrusiveRefCntPtr<ReadTracker> Tracker;
+  IntrusiveRefCntPtr<vfs::OverlayFileSystem> GroupFS;
+  if (GroupSize > 1) {
+    Tracker = makeIntrusiveRefCnt<ReadTracker>(BaseFS);
+    GroupFS = makeIntrusiveRefCnt<vfs::OverlayFileSystem>(Tracker);
+  }
+
+  ClangTidyGlobalOptions GlobalOptions;
+  if (!LineFilter.empty())
+    if (std::error_code EC = parseLineFilter(LineFilter, GlobalOptions)) {
+      errs() << "caos-batch: invalid -line-filter: " << EC.message() << "\n";
+      return 1;
+    }
+  if (!DiffFile.empty()) {
+    llvm::ErrorOr<std::unique_ptr<MemoryBuffer>> Diff =
+        MemoryBuffer::getFileOrSTDIN(DiffFile);
+    if (!Diff) {
+      errs() << "caos-batch: cannot read " << DiffFile << ": "
+             << Diff.getError().message() << "\n";
+      return 1;
+    }
+    parseUnifiedDiff((*Diff)->getBuffer(), DiffStrip, MountPoint,
+                     GlobalOptions.LineFilter);
+    // Without any entry, the line filter would keep everything.
+    if (GlobalOptions.LineFilter.empty())
+      GlobalOptions.LineFilter.push_back({"", {{0, 0}}});
+  }
+  ClangTidyOptions DefaultOptions = ClangTidyOptions::getDefaults();
+  DefaultOptions.Checks = "-*,caos-*";
+  ClangTidyOptions OverrideOptions;
+  if (!Checks.empty())
+    OverrideOptions.Checks = Checks;
+
+  std::unique_ptr<ClangTidyOptionsProvider> OptionsProvider;
+  if (!Config.empty()) {
+    llvm::ErrorOr<ClangTidyOptions> ParsedConfig =
+        parseConfiguration(MemoryBufferRef(Config, "-config"));
+    if (!ParsedConfig) {
+      errs() << "caos-batch: invalid configuration: "
+             << ParsedConfig.getError().message() << "\n";
+      return 1;
+    }
+    OptionsProvider = std::make_unique<ConfigOptionsProvider>(
+        GlobalOptions, DefaultOptions, std::move(*ParsedConfig),
+        OverrideOptions, BaseFS);
+  } else {
+    OptionsProvider = std::make_unique<FileOptionsProvider>(
+        GlobalOptions, DefaultOptions, OverrideOptions, BaseFS);
+  }
+  ClangTidyContext Context(std::move(OptionsProvider));
+
+  SmallVector<StringRef, 4> AnalysedExtensions;
+  SplitString(Extensions, AnalysedExtensions, ",");
+
+  std::unique_ptr<raw_fd_ostream> Output;
+  if (OutputFD >= 0) {
+    Output = std::make_unique<raw_fd_ostream>(OutputFD, /*shouldClose=*/false);
+  } else {
+    std::error_code EC;
+    Output = std::make_unique<raw_fd_ostream>(OutputFile, EC,
+                                              sys::fs::OF_None);
+    if (EC) {
+      errs() << "caos-batch: cannot open " << OutputFile << ": "
+             << EC.message() << "\n";
+      return 1;
+    }
+  }
+
+  std::unique_ptr<ResultStoreWriter> Store;
+  if (!StorePath.empty()) {
+    llvm::Expected<std::unique_ptr<ResultStoreWriter>> Opened =
+        ResultStoreWriter::open(StorePath);
+    if (!Opened) {
+      errs() << "caos-batch: cannot open the results store: "
+             << toString(Opened.takeError()) << "\n";
+      return 1;
+    }
+    Store = std::move(*Opened);
+  }
+  const std::string SubmissionName =
+      Submission.empty() ? sys::path::stem(ArchivePath).str()
+                         : Submission.getValue();
+
+  LineLocator Locator(*BaseFS);
+  auto MakeFormatSink =
+      [&](raw_ostream &OS) -> std::unique_ptr<DiagnosticSink> {
+    if (Format == OutputFormat::JSONLines)
+      return std::make_unique<JSONLinesDiagnosticSink>(OS, Locator,
+                                                       MountPoint);
+    if (Format == OutputFormat::Binary)
+      return std::make_unique<BinaryDiagnosticSink>(OS, Locator, MountPoint);
+    return std::make_unique<TextDiagnosticSink>(OS, Locator, MountPoint);
+  };
+  // Workers append to the store themselves; it serialises the appends.
+  auto MakeSink = [&](raw_ostream &OS) -> std::unique_ptr<DiagnosticSink> {
+    if (!Store)
+      return MakeFormatSink(OS);
+    return std::make_unique<StoreDiagnosticSink>(
+        *Store, Locator, MountPoint, SubmissionName, MakeFormatSink(OS));
+  };
+
+  std::vector<Unit> Units;
+  for (const TarArchive::Member &Member : (*Archive)->members()) {
+    StringRef Extension = sys::path::extension(Member.Name);
+    if (!Extension.consume_front(".") ||
+        !llvm::is_contained(AnalysedExtensions, Extension))
+      continue;
+
+    SmallString<256> Path(MountPoint.getValue());
+    sys::path::append(Path, Member.Name);
+    Units.push_back({Member.Name, std::string(Path), Member.Data.size()});
+  }
+
+  std::vector<std::vector<Unit>> Groups =
+      groupByFlags(std::move(Units), *Compilations, GroupSize);
+
+  // Groups run in archive order unless they are scheduled.
+  TimingHistory Timings;
+  if (!TimingsFile.empty()) {
+    llvm::Expected<TimingHistory> Loaded = TimingHistory::load(TimingsFile);
+    if (!Loaded) {
+      errs() << "caos-batch: " << toString(Loaded.takeError()) << "\n";
+      return 1;
+    }
+    Timings = std::move(*Loaded);
+  }
+  if (!ScheduleFile.empty()) {
+    llvm::ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+        MemoryBuffer::getFile(ScheduleFile);
+    if (!Buffer) {
+      errs() << "caos-batch: cannot read " << ScheduleFile << ": "
+             << Buffer.getError().message() << "\n";
+      return 1;
+    }
+    llvm::Expected<ScheduleRules> Rules =
+        ScheduleRules::parse((*Buffer)->getBuffer(), TenantQuota);
+    if (!Rules) {
+      errs() << "caos-batch: invalid -schedule: "
+             << toString(Rules.takeError()) << "\n";
+      return 1;
+    }
+    Groups = scheduleGroups(std::move(Groups), *Rules, Timings);
+  }
+
+  // Analyses Group, reporting its findings to Sink. Returns the number of its
+  // units with warnings treated as errors.
+  auto RunGroup = [&](const std::vector<Unit> &Group,
+                      DiagnosticSink &Sink) -> unsigned {
+    unsigned UnitsWithErrors = 0;
+    auto Consume = [&](StringRef Name, ArrayRef<ClangTidyError> Errors) {
+      Sink.consume(Name, Errors);
+      if (llvm::any_of(Errors, [](const ClangTidyError &Error) {
+            return Error.IsWarningAsError;
+          }))
+        ++UnitsWithErrors;
+    };
+
+    std::vector<std::string> Paths;
+    for (const Unit &U : Group)
+      Paths.push_back(U.Path);
+    if (Group.size() == 1) {
+      Consume(Group.front().Name,
+              runClangTidy(Context, *Compilations, Paths, BaseFS,
+                           /*ApplyAnyFix=*/false));
+      return UnitsWithErrors;
+    }
+
+    // The errors of the run are deduplicated across its translation units:
+    // each is reported under every member that read its file.
+    Tracker->clear();
+    const TrackingCompilationDatabase TrackedCompilations(*Compilations,
+                                                          *Tracker);
+    std::vector<ClangTidyError> Errors =
+        runClangTidy(Context, TrackedCompilations, Paths, GroupFS,
+                     /*ApplyAnyFix=*/false);
+    std::vector<std::vector<ClangTidyError>> ByMember(Group.size());
+    llvm::MapVector<std::string, std::vector<ClangTidyError>> Unattributed;
+    for (ClangTidyError &Error : Errors) {
+      // Diagnostics without a location, such as an exceeded budget, point at
+      // their translation unit with a note.
+      StringRef Path = Error.Message.FilePath;
+      if (Path.empty() && !Error.Notes.empty())
+        Path = Error.Notes.front().FilePath;
+      SmallString<256> File(Path);
+      if (!File.empty())
+        sys::fs::make_absolute(Error.BuildDirectory, File);
+      bool Attributed = false;
+      for (size_t I = 0; I < Group.size(); ++I) {
+        // Those that have no file at all are about every member.
+        if (!File.empty() && !Tracker->hasRead(Group[I].Path, File))
+          continue;
+        ByMember[I].push_back(Error);
+        Attributed = true;
+      }
+      if (!Attributed)
+        Unattributed[Path.str()].push_back(std::move(Error));
+    }
+    for (size_t I = 0; I < Group.size(); ++I)
+      Consume(Group[I].Name, ByMember[I]);
+    // Findings in a file no member was seen reading are reported under it,
+    // and it is not counted as a unit.
+    for (const auto &[File, FileErrors] : Unattributed)
+      Sink.consume(getDisplayPath(File, MountPoint), FileErrors);
+    return UnitsWithErrors;
+  };
+
+  // The time of a group is shared by its members in proportion to their size.
+  auto RecordTime = [&Timings](const std::vector<Unit> &Group,
+                               double Milliseconds) {
+    uint64_t TotalSize = 0;
+    for (const Unit &U : Group)
+      TotalSize += U.Size;
+    for (const Unit &U : Group)
+      Timings.record(U.Name, U.Size,
+                     TotalSize == 0 ? Milliseconds / Group.size()
+                                    : Milliseconds * U.Size / TotalSize);
+  };
+
+  unsigned FilesWithErrors = 0;
+  unsigned FailedUnits = 0;
+  if (Workers <= 1) {
+    // One group at a time, so that results are reported as soon as each
+    // group is done; by default a group is a single member.
+    std::unique_ptr<DiagnosticSink> Sink = MakeSink(*Output);
+    for (const std::vector<Unit> &Group : Groups) {
+      const auto Start = std::chrono::steady_clock::now();
+      FilesWithErrors += RunGroup(Group, *Sink);
+      RecordTime(Group, getMillisecondsSince(Start));
+    }
+  } else {
+    // Each worker reports a group into a buffer, which the coordinator
+    // writes out once the groups before it are done.
+    Output->flush();
+    llvm::Error Err = runShards(
+        Groups.size(), Workers, WorkerRetries,
+        [&](size_t Index) {
+          ShardResult Result;
+          raw_string_ostream OS(Result.Output);
+          const auto Start = std::chrono::steady_clock::now();
+          Result.UnitsWithErrors = RunGroup(Groups[Index], *MakeSink(OS));
+          Result.Milliseconds = getMillisecondsSince(Start);
+          OS.flush();
+          // The coordinator writes the totals of the run at exit; the
+          // workers only write the per-file statistics.
+          Result.Statistics = takeStatisticsTotals();
+          // Likewise, the coordinator writes the header snapshot.
+          if (Recorder)
+            Result.HeaderLookups = Recorder->takeLookups();
+          return Result;
+        },
+        [&](size_t Index, const ShardResult &Result) {
+          const std::vector<Unit> &Group = Groups[Index];
+          if (Result.Failed) {
+            for (const Unit &U : Group)
+              errs() << "caos-batch: " << U.Name
+                     << ": not analysed, its workers crashed\n";
+            FailedUnits += Group.size();
+            return;
+          }
+          *Output << Result.Output;
+          Output->flush();
+          mergeStatisticsTotals(Result.Statistics);
+          if (Recorder)
+            Recorder->mergeLookups(Result.HeaderLookups);
+          FilesWithErrors += Result.UnitsWithErrors;
+          RecordTime(Group, Result.Milliseconds);
+        });
+    if (Err) {
+      errs() << "caos-batch: " << toString(std::move(Err)) << "\n";
+      return 1;
+    }
+  }
+  if (Recorder)
+    if (llvm::Error Err = Recorder->write(SystemHeaderSnapshot))
+      errs() << "caos-batch: cannot write the header snapshot: "
+             << toString(std::move(Err)) << "\n";
+
+  if (!TimingsFile.empty())
+    if (llvm::Error Err = Timings.save(TimingsFile))
+      errs() << "caos-batch: cannot write the timings: "
+             << toString(std::move(Err)) << "\n";
+
+  if (FailedUnits > 0)
+    errs() << FailedUnits << " unit(s) not analysed\n";
+  if (FilesWithErrors > 0)
+    errs() << FilesWithErrors << " unit(s) with warnings treated as errors\n";
+  return FailedUnits > 0 || FilesWithErrors > 0 ? 1 : 0;
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+int main(int Argc, const char **Argv) {
+  return clang::tidy::caos::caosBatchMain(Argc, Argv);
+}
@@ -0,0 +1,20 @@
+//===--- CaosClangTidy.cpp - caos-clang-tidy ------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// clang-tidy with the CAOS module linked in, so that neither --load nor the
+// shared plugin is needed. The CAOS checks register themselves through the
+// static ClangTidyModuleRegistry entry of CaosTidyModule.cpp, which is part of
+// this executable; the upstream modules come with clangTidyMain.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../../clang-tidy/tool/ClangTidyMain.h"
+
+int main(int argc, const char **argv) {
+  return clang::tidy::clangTidyMain(argc, argv);
+}
@@ -0,0 +1,271 @@
+//===--- CaosQuery.cpp - caos-query ---------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Counts the findings of a results store written by caos-batch -store, grouped
+// by any of its columns and the student, e.g. the magic numbers per student
+// and assignment:
+//
+//   caos-query store --where=check=caos-magic-numbers \
+//     --group-by=submission,student
+//
+// The columns are mapped and scanned as arrays of dictionary indices, and the
+// counts kept in a flat array indexed by the combination of indices when it
+// is small enough, so a query runs at about the speed memory can be read.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ResultStore.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+static cl::OptionCategory CaosQueryCategory("caos-query options");
+
+static cl::opt<std::string> StoreDirectory(cl::Positional, cl::Required,
+                                           cl::desc("<store directory>"),
+                                           cl::cat(CaosQueryCategory));
+
+static cl::list<std::string> GroupBy("group-by", cl::desc(R"(
+Comma-separated keys to count the findings by:
+check, file, line, value, submission or student.
+Defaults to check.
+)"),
+                                     cl::CommaSeparated,
+                                     cl::cat(CaosQueryCategory));
+
+static cl::list<std::string> Where("where", cl::desc(R"(
+<key>=<value>: only count the findings with that
+value. Conditions on different keys must all hold,
+conditions on the same key are alternatives.
+)"),
+                                   cl::cat(CaosQueryCategory));
+
+static cl::opt<unsigned> StudentDepth("student-depth", cl::desc(R"(
+Number of leading components of the file that
+identify the student.
+)"),
+                                      cl::init(1),
+                                      cl::cat(CaosQueryCategory));
+
+static cl::opt<bool> SortByCount("sort-by-count", cl::desc(R"(
+Sort the groups by decreasing count rather than by
+key.
+)"),
+                                 cl::init(false), cl::cat(CaosQueryCategory));
+
+namespace {
+
+/// Something to group or filter by: a column of the store, or the student,
+/// which is derived from the file.
+struct Key {
+  std::string Name;
+  /// The column the key is read from.
+  StoreColumn Column;
+  /// Maps the values of the column to those of the key, if they differ.
+  std::vector<uint32_t> Mapping;
+  /// The strings of the values of the key; empty for the line.
+  std::vector<std::string> Strings;
+  /// The values of the key are below this.
+  uint64_t Size;
+
+  uint32_t get(const ResultStoreReader::Value *Column, size_t Row) const {
+    return Mapping.empty() ? uint32_t(Column[Row]) : Mapping[Column[Row]];
+  }
+
+  std::string format(uint32_t V) const {
+    return Strings.empty() ? std::to_string(V) : Strings[V];
+  }
+};
+
+} // namespace
+
+static std::optional<Key> getKey(StringRef Name,
+                                 const ResultStoreReader &Store) {
+  Key K;
+  K.Name = Name.str();
+  if (Name == "student") {
+    // The files map to the students, numbered in order of appearance.
+    K.Column = StoreColumn::File;
+    StringMap<uint32_t> Students;
+    for (StringRef File : Store.dictionary(StoreColumn::File)) {
+      SmallVector<StringRef, 4> Components;
+      File.split(Components, '/', StudentDepth);
+      if (Components.size() > StudentDepth)
+        Components.pop_back();
+      auto [It, Inserted] =
+          Students.try_emplace(join(Components, "/"), K.Strings.size());
+      if (Inserted)
+        K.Strings.push_back(It->first().str());
+      K.Mapping.push_back(It->second);
+    }
+    K.Size = K.Strings.size();
+    return K;
+  }
+
+  std::optional<StoreColumn> Column = getColumnByName(Name);
+  if (!Column)
+    return std::nullopt;
+  K.Column = *Column;
+  if (K.Column == StoreColumn::Line) {
+    uint32_t MaxLine = 0;
+    for (ResultStoreReader::Value Line : Store.column(StoreColumn::Line))
+      MaxLine = std::max<uint32_t>(MaxLine, Line);
+    K.Size = uint64_t(MaxLine) + 1;
+    return K;
+  }
+  for (StringRef S : Store.dictionary(K.Column))
+    K.Strings.push_back(S.str());
+  K.Size = K.Strings.size();
+  return K;
+}
+
+static int caosQueryMain(int Argc, const char **Argv) {
+  InitLLVM X(Argc, Argv);
+  cl::HideUnrelatedOptions(CaosQueryCategory);
+  cl::ParseCommandLineOptions(
+      Argc, Argv, "Counts the findings of a caos-batch results store.\n");
+  if (GroupBy.empty())
+    GroupBy.push_back("check");
+
+  Expected<std::unique_ptr<ResultStoreReader>> Store =
+      ResultStoreReader::load(StoreDirectory);
+  if (!Store) {
+    errs() << "caos-query: cannot read the store: "
+           << toString(Store.takeError()) << "\n";
+    return 1;
+  }
+  const size_t NumRows = (*Store)->size();
+
+  // The rows to count: those that pass every condition. Each condition is a
+  // set of accepted values of its key.
+  std::vector<std::pair<Key, BitVector>> Conditions;
+  for (StringRef Condition : Where) {
+    auto [Name, Value] = Condition.split('=');
+    std::optional<Key> K = getKey(Name, **Store);
+    if (!K) {
+      errs() << "caos-query: unknown key in -where: " << Name << "\n";
+      return 1;
+    }
+    auto It = llvm::find_if(Conditions, [&](const auto &C) {
+      return C.first.Name == K->Name;
+    });
+    if (It == Conditions.end()) {
+      Conditions.emplace_back(*K, BitVector(K->Size));
+      It = std::prev(Conditions.end());
+    }
+    if (K->Strings.empty()) {
+      unsigned Line;
+      if (!Value.getAsInteger(10, Line) && Line < K->Size)
+        It->second.set(Line);
+      continue;
+    }
+    // A value that isn't in the store matches no row.
+    for (size_t I = 0; I < K->Strings.size(); ++I)
+      if (K->Strings[I] == Value)
+        It->second.set(I);
+  }
+
+  std::vector<Key> Keys;
+  for (StringRef Name : GroupBy) {
+    std::optional<Key> K = getKey(Name, **Store);
+    if (!K) {
+      errs() << "caos-query: unknown key in -group-by: " << Name << "\n";
+      return 1;
+    }
+    Keys.push_back(std::move(*K));
+  }
+
+  // A group is numbered by the values of its keys, as the digits of a number
+  // in mixed radix.
+  uint64_t NumGroups = 1;
+  for (const Key &K : Keys) {
+    if (K.Size != 0 && NumGroups > UINT64_MAX / K.Size) {
+      errs() << "caos-query: too many groups\n";
+      return 1;
+    }
+    NumGroups *= std::max<uint64_t>(K.Size, 1);
+  }
+
+  std::vector<const ResultStoreReader::Value *> ConditionColumns;
+  for (const auto &[K, Accepted] : Conditions)
+    ConditionColumns.push_back((*Store)->column(K.Column).data());
+  std::vector<const ResultStoreReader::Value *> KeyColumns;
+  for (const Key &K : Keys)
+    KeyColumns.push_back((*Store)->column(K.Column).data());
+
+  // Flat counts when they fit in a few megabytes, a hash map otherwise.
+  constexpr uint64_t MaxFlatGroups = 1 << 20;
+  std::vector<uint64_t> FlatCounts(NumGroups <= MaxFlatGroups ? NumGroups : 0);
+  DenseMap<uint64_t, uint64_t> SparseCounts;
+  for (size_t Row = 0; Row < NumRows; ++Row) {
+    bool Accepted = true;
+    for (size_t I = 0; I < Conditions.size() && Accepted; ++I)
+      Accepted = Conditions[I].second.test(
+          Conditions[I].first.get(ConditionColumns[I], Row));
+    if (!Accepted)
+      continue;
+    uint64_t Group = 0;
+    for (size_t I = 0; I < Keys.size(); ++I)
+      Group = Group * Keys[I].Size + Keys[I].get(KeyColumns[I], Row);
+    if (FlatCounts.empty())
+      ++SparseCounts[Group];
+    else
+      ++FlatCounts[Group];
+  }
+
+  std::vector<std::pair<std::vector<std::string>, uint64_t>> Results;
+  auto AddResult = [&](uint64_t Group, uint64_t Count) {
+    std::vector<std::string> Values(Keys.size());
+    for (size_t I = Keys.size(); I-- > 0;) {
+      Values[I] = Keys[I].format(Group % Keys[I].Size);
+      Group /= Keys[I].Size;
+    }
+    Results.emplace_back(std::move(Values), Count);
+  };
+  for (uint64_t Group = 0; Group < FlatCounts.size(); ++Group)
+    if (FlatCounts[Group] != 0)
+      AddResult(Group, FlatCounts[Group]);
+  for (const auto &[Group, Count] : SparseCounts)
+    AddResult(Group, Count);
+
+  if (SortByCount)
+    llvm::stable_sort(Results, [](const auto &L, const auto &R) {
+      return L.second > R.second;
+    });
+  else
+    llvm::sort(Results);
+
+  outs() << join(GroupBy, "\t") << "\tcount\n";
+  for (const auto &[Values, Count] : Results)
+    outs() << join(Values, "\t") << '\t' << Count << '\n';
+  return 0;
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+int main(int Argc, const char **Argv) {
+  return clang::tidy::caos::caosQueryMain(Argc, Argv);
+}
@@ -0,0 +1,413 @@
+//===--- CaosResults.cpp - caos-results -----------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Converts the binary findings written by caos-batch --format=binary to
+// clang-tidy's export-fixes YAML, JSON Lines, SARIF, or a count of findings per
+// student and check. The inputs are mapped into memory and read a unit at a
+// time, so only the summary keeps anything across units.
+//
+//===----------------------------------------------------------------------===//
+
+#include "BinaryDiagnostics.h"
+#include "clang/Tooling/Core/Diagnostic.h"
+#include "clang/Tooling/DiagnosticsYaml.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+#include <map>
+#include <vector>
+
+using namespace llvm;
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+static cl::OptionCategory CaosResultsCategory("caos-results options");
+
+static cl::list<std::string> InputFiles(cl::Positional,
+                                        cl::desc("[<findings> ...]"),
+                                        cl::cat(CaosResultsCategory));
+
+enum class OutputFormat { YAML, JSONLines, SARIF, Summary };
+
+static cl::opt<OutputFormat> Format(
+    "format", cl::desc("Output format of the findings."),
+    cl::values(clEnumValN(OutputFormat::YAML, "yaml",
+                          "clang-tidy -export-fixes, one document per unit "
+                          "(default)"),
+               clEnumValN(OutputFormat::JSONLines, "jsonl",
+                          "one JSON object per finding, as caos-batch"),
+               clEnumValN(OutputFormat::SARIF, "sarif", "SARIF 2.1.0"),
+               clEnumValN(OutputFormat::Summary, "summary",
+                          "number of findings per student and check")),
+    cl::init(OutputFormat::YAML), cl::cat(CaosResultsCategory));
+
+static cl::opt<unsigned> StudentDepth("student-depth", cl::desc(R"(
+Number of leading components of the unit name that
+identify a student in -format=summary.
+)"),
+                                      cl::init(1),
+                                      cl::cat(CaosResultsCategory));
+
+static cl::opt<std::string> OutputFile("output", cl::desc(R"(
+File to write to. Defaults to stdout.
+)"),
+                                       cl::init("-"),
+                                       cl::cat(CaosResultsCategory));
+
+static StringRef getLevel(BinaryLevel Level) {
+  switch (Level) {
+  case BinaryLevel::Warning:
+    return "warning";
+  case BinaryLevel::Error:
+    return "error";
+  case BinaryLevel::Remark:
+    return "remark";
+  }
+  llvm_unreachable("unknown level");
+}
+
+static tooling::Diagnostic::Level getDiagnosticLevel(BinaryLevel Level) {
+  switch (Level) {
+  case BinaryLevel::Warning:
+    return tooling::Diagnostic::Warning;
+  case BinaryLevel::Error:
+    return tooling::Diagnostic::Error;
+  case BinaryLevel::Remark:
+    return tooling::Diagnostic::Remark;
+  }
+  llvm_unreachable("unknown level");
+}
+
+namespace {
+
+/// Receives the units of all inputs, in order.
+class ResultWriter {
+public:
+  virtual ~ResultWriter() = default;
+
+  virtual void unit(const BinaryUnit &Unit) = 0;
+  /// Called after the last unit.
+  virtual void finish() {}
+};
+
+class YAMLWriter : public ResultWriter {
+public:
+  explicit YAMLWriter(raw_ostream &OS) : YAML(OS) {}
+
+  void unit(const BinaryUnit &Unit) override {
+    tooling::TranslationUnitDiagnostics TU;
+    TU.MainSourceFile = Unit.Name.str();
+    for (const BinaryDiagnostic &D : Unit.Diagnostics) {
+      tooling::DiagnosticMessage Message;
+      Message.Message = D.Message.str();
+      Message.FilePath = D.File.str();
+      Message.FileOffset = D.Offset;
+      for (const BinaryReplacement &R : D.Fixes) {
+        // The replacements of a finding were valid when it was written, so
+        // a conflict means the input is not what caos-batch wrote.
+        if (Error Err = Message.Fix[R.File].add(
+                tooling::Replacement(R.File, R.Offset, R.Length, R.Text)))
+          errs() << "caos-results: " << Unit.Name << ": "
+                 << toString(std::move(Err)) << "\n";
+      }
+      SmallVector<tooling::DiagnosticMessage, 1> Notes;
+      for (const BinaryNote &N : D.Notes) {
+        tooling::DiagnosticMessage &Note = Notes.emplace_back();
+        Note.Message = N.Message.str();
+        Note.FilePath = N.File.str();
+        Note.FileOffset = N.Offset;
+      }
+      TU.Diagnostics.emplace_back(D.Check, Message, Notes,
+                                  getDiagnosticLevel(D.Level),
+                                  /*BuildDirectory=*/"");
+    }
+    YAML << TU;
+  }
+
+private:
+  yaml::Output YAML;
+};
+
+class JSONLinesWriter : public ResultWriter {
+public:
+  explicit JSONLinesWriter(raw_ostream &OS) : OS(OS) {}
+
+  void unit(const BinaryUnit &Unit) override {
+    for (const BinaryDiagnostic &D : Unit.Diagnostics) {
+      json::OStream J(OS);
+      J.object([&] {
+        J.attribute("unit", Unit.Name);
+        J.attribute("check", D.Check);
+        J.attribute("file", D.File);
+        J.attribute("line", D.Line);
+        J.attribute("col", D.Column);
+        J.attribute("level", getLevel(D.Level));
+        J.attribute("message", D.Message);
+        J.attributeArray("fix", [&] {
+          for (const BinaryReplacement &R : D.Fixes)
+            J.object([&] {
+              J.attribute("file", R.File);
+              J.attribute("offset", R.Offset);
+              J.attribute("length", R.Length);
+              J.attribute("replacement", R.Text);
+            });
+        });
+        J.attributeArray("notes", [&] {
+          for (const BinaryNote &N : D.Notes)
+            J.object([&] {
+              J.attribute("file", N.File);
+              J.attribute("line", N.Line);
+              J.attribute("col", N.Column);
+              J.attribute("message", N.Message);
+            });
+        });
+      });
+      OS << '\n';
+    }
+  }
+
+private:
+  raw_ostream &OS;
+};
+
+/// Writes a single SARIF run. The results are streamed as they are read; the
+/// rules they refer to by index are written after them.
+class SARIFWriter : public ResultWriter {
+public:
+  explicit SARIFWriter(raw_ostream &OS) : OS(OS), J(OS, /*IndentSize=*/2) {
+    J.objectBegin();
+    J.attribute("$schema", "https://json.schemastore.org/sarif-2.1.0.json");
+    J.attribute("version", "2.1.0");
+    J.attributeBegin("runs");
+    J.arrayBegin();
+    J.objectBegin();
+    J.attributeBegin("results");
+    J.arrayBegin();
+  }
+
+  void unit(const BinaryUnit &Unit) override {
+    for (const BinaryDiagnostic &D : Unit.Diagnostics) {
+      auto [It, Inserted] = RuleIndices.try_emplace(D.Check, Rules.size());
+      if (Inserted)
+        Rules.push_back(D.Check.str());
+      const unsigned RuleIndex = It->second;
+      J.object([&] {
+        J.attribute("ruleId", D.Check);
+        J.attribute("ruleIndex", RuleIndex);
+        // SARIF has no remarks; its closest level is a note.
+        J.attribute("level", D.Level == BinaryLevel::Remark
+                                 ? StringRef("note")
+                                 : getLevel(D.Level));
+        J.attributeObject("message",
+                          [&] { J.attribute("text", D.Message); });
+        J.attributeArray("locations", [&] {
+          if (!D.File.empty())
+            location(D.File, D.Line, D.Column);
+        });
+        // A note without a location has nowhere to point to.
+        if (llvm::any_of(D.Notes,
+                         [](const BinaryNote &N) { return !N.File.empty(); }))
+          J.attributeArray("relatedLocations", [&] {
+            for (const BinaryNote &N : D.Notes)
+              if (!N.File.empty())
+                location(N.File, N.Line, N.Column, N.Message);
+          });
+        if (!D.Fixes.empty())
+          J.attributeArray("fixes", [&] { fix(D.Fixes); });
+        J.attributeObject("properties",
+                          [&] { J.attribute("unit", Unit.Name); });
+      });
+    }
+  }
+
+  void finish() override {
+    J.arrayEnd();
+    J.attributeEnd();
+    J.attributeObject("tool", [&] {
+      J.attributeObject("driver", [&] {
+        J.attribute("name", "caos-batch");
+        J.attributeArray("rules", [&] {
+          for (const std::string &Rule : Rules)
+            J.object([&] { J.attribute("id", Rule); });
+        });
+      });
+    });
+    J.objectEnd();
+    J.arrayEnd();
+    J.attributeEnd();
+    J.objectEnd();
+    OS << '\n';
+  }
+
+private:
+  void location(StringRef File, unsigned Line, unsigned Column,
+                StringRef Message = "") {
+    J.object([&] {
+      if (!Message.empty())
+        J.attributeObject("message", [&] { J.attribute("text", Message); });
+      J.attributeObject("physicalLocation", [&] {
+        J.attributeObject("artifactLocation",
+                          [&] { J.attribute("uri", File); });
+        // Line 0 means the file could not be read to locate the finding.
+        if (Line != 0)
+          J.attributeObject("region", [&] {
+            J.attribute("startLine", Line);
+            J.attribute("startColumn", Column);
+          });
+      });
+    });
+  }
+
+  void fix(ArrayRef<BinaryReplacement> Replacements) {
+    J.object([&] {
+      J.attributeArray("artifactChanges", [&] {
+        for (size_t Begin = 0, End; Begin < Replacements.size();
+             Begin = End) {
+          // Replacements come sorted by file.
+          StringRef File = Replacements[Begin].File;
+          for (End = Begin;
+               End < Replacements.size() && Replacements[End].File == File;
+               ++End)
+            ;
+          J.object([&] {
+            J.attributeObject("artifactLocation",
+                              [&] { J.attribute("uri", File); });
+            J.attributeArray("replacements", [&] {
+              for (const BinaryReplacement &R :
+                   Replacements.slice(Begin, End - Begin))
+                J.object([&] {
+                  J.attributeObject("deletedRegion", [&] {
+                    J.attribute("byteOffset", R.Offset);
+                    J.attribute("byteLength", R.Length);
+                  });
+                  J.attributeObject("insertedContent",
+                                    [&] { J.attribute("text", R.Text); });
+                });
+            });
+          });
+        }
+      });
+    });
+  }
+
+  raw_ostream &OS;
+  json::OStream J;
+  /// The checks, in order of first appearance, and their indices.
+  std::vector<std::string> Rules;
+  StringMap<unsigned> RuleIndices;
+};
+
+/// Counts the findings of each student per check, and writes them sorted by
+/// student and check:
+/// \code
+///   alice  caos-magic-numbers  3
+/// \endcode
+class SummaryWriter : public ResultWriter {
+public:
+  explicit SummaryWriter(raw_ostream &OS) : OS(OS) {}
+
+  void unit(const BinaryUnit &Unit) override {
+    std::map<std::string, unsigned> &Counts = Students[getStudent(Unit.Name)];
+    for (const BinaryDiagnostic &D : Unit.Diagnostics)
+      ++Counts[D.Check.str()];
+  }
+
+  void finish() override {
+    for (const auto &[Student, Counts] : Students)
+      for (const auto &[Check, Count] : Counts)
+        OS << Student << '\t' << Check << '\t' << Count << '\n';
+  }
+
+private:
+  static std::string getStudent(StringRef Unit) {
+    SmallVector<StringRef, 4> Components;
+    Unit.split(Components, '/', StudentDepth);
+    if (Components.size() > StudentDepth)
+      Components.pop_back();
+    return join(Components, "/");
+  }
+
+  raw_ostream &OS;
+  std::map<std::string, std::map<std::string, unsigned>> Students;
+};
+
+} // namespace
+
+static int caosResultsMain(int Argc, const char **Argv) {
+  InitLLVM X(Argc, Argv);
+  cl::HideUnrelatedOptions(CaosResultsCategory);
+  cl::ParseCommandLineOptions(
+      Argc, Argv,
+      "Converts the findings of caos-batch -format=binary.\n");
+  if (InputFiles.empty())
+    InputFiles.push_back("-");
+
+  std::error_code EC;
+  raw_fd_ostream Output(OutputFile, EC, sys::fs::OF_Text);
+  if (EC) {
+    errs() << "caos-results: cannot open " << OutputFile << ": "
+           << EC.message() << "\n";
+    return 1;
+  }
+
+  std::unique_ptr<ResultWriter> Writer;
+  switch (Format) {
+  case OutputFormat::YAML:
+    Writer = std::make_unique<YAMLWriter>(Output);
+    break;
+  case OutputFormat::JSONLines:
+    Writer = std::make_unique<JSONLinesWriter>(Output);
+    break;
+  case OutputFormat::SARIF:
+    Writer = std::make_unique<SARIFWriter>(Output);
+    break;
+  case OutputFormat::Summary:
+    Writer = std::make_unique<SummaryWriter>(Output);
+    break;
+  }
+
+  bool Failed = false;
+  for (const std::string &Path : InputFiles) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+        MemoryBuffer::getFileOrSTDIN(Path, /*IsText=*/false,
+                                     /*RequiresNullTerminator=*/false);
+    if (!Buffer) {
+      errs() << "caos-results: cannot read " << Path << ": "
+             << Buffer.getError().message() << "\n";
+      Failed = true;
+      continue;
+    }
+    if (Error Err = readBinaryUnits(
+            (*Buffer)->getBuffer(),
+            [&Writer](const BinaryUnit &Unit) { Writer->unit(Unit); })) {
+      errs() << "caos-results: " << Path << ": " << toString(std::move(Err))
+             << "\n";
+      Failed = true;
+    }
+  }
+  Writer->finish();
+  return Failed ? 1 : 0;
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+int main(int Argc, const char **Argv) {
+  return clang::tidy::caos::caosResultsMain(Argc, Argv);
+}
@@ -0,0 +1,223 @@
+//===--- DiagnosticSink.cpp - caos-batch ----------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "DiagnosticSink.h"
+#include "BinaryDiagnostics.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/JSON.h"
+#include <vector>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+const llvm::MemoryBuffer *LineLocator::getBuffer(StringRef Path) {
+  if (Path != CachedPath) {
+    CachedPath = Path.str();
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> File =
+        FS.getBufferForFile(Path);
+    Buffer = File ? std::move(*File) : nullptr;
+  }
+  return Buffer.get();
+}
+
+std::pair<unsigned, unsigned> LineLocator::locate(StringRef Path,
+                                                  unsigned Offset) {
+  const llvm::MemoryBuffer *File = getBuffer(Path);
+  if (!File || Offset > File->getBufferSize())
+    return {0, 0};
+  StringRef Before = File->getBuffer().take_front(Offset);
+  size_t LineStart = Before.rfind('\n');
+  LineStart = LineStart == StringRef::npos ? 0 : LineStart + 1;
+  return {static_cast<unsigned>(Before.count('\n')) + 1,
+          static_cast<unsigned>(Offset - LineStart) + 1};
+}
+
+std::string LineLocator::getTokenAt(StringRef Path, unsigned Offset) {
+  const llvm::MemoryBuffer *File = getBuffer(Path);
+  if (!File || Offset >= File->getBufferSize())
+    return "";
+  const StringRef Rest = File->getBuffer().drop_front(Offset);
+  if (!llvm::isAlnum(Rest[0]) && Rest[0] != '_' && Rest[0] != '.')
+    return "";
+  // A pp-number (1.5e-3f, 0x1p+4, 1'000) or an identifier.
+  const bool IsNumber = llvm::isDigit(Rest[0]) || Rest[0] == '.';
+  size_t End = 1;
+  while (End < Rest.size()) {
+    const char C = Rest[End];
+    if (llvm::isAlnum(C) || C == '_' ||
+        (IsNumber && (C == '.' || C == '\'' ||
+                      ((C == '+' || C == '-') &&
+                       StringRef("eEpP").contains(Rest[End - 1])))))
+      ++End;
+    else
+      break;
+  }
+  return Rest.take_front(End).str();
+}
+
+StringRef getDisplayPath(StringRef Path, StringRef Prefix) {
+  StringRef Relative = Path;
+  if (!Prefix.empty() && Relative.consume_front(Prefix) &&
+      Relative.consume_front("/"))
+    return Relative;
+  return Path;
+}
+
+// The line and column of Message, or 0 and 0 if it has no location.
+static std::pair<unsigned, unsigned>
+locate(LineLocator &Locator, const tooling::DiagnosticMessage &Message) {
+  if (Message.FilePath.empty())
+    return {0, 0};
+  return Locator.locate(Message.FilePath, Message.FileOffset);
+}
+
+static StringRef getLevel(const ClangTidyError &Error) {
+  if (Error.DiagLevel == tooling::Diagnostic::Error || Error.IsWarningAsError)
+    return "error";
+  if (Error.DiagLevel == tooling::Diagnostic::Remark)
+    return "remark";
+  return "warning";
+}
+
+void TextDiagnosticSink::consume(StringRef Unit,
+                                 ArrayRef<ClangTidyError> Errors) {
+  for (const ClangTidyError &Error : Errors) {
+    const tooling::DiagnosticMessage &Message = Error.Message;
+    OS << Unit << ": ";
+    if (!Message.FilePath.empty()) {
+      auto [Line, Column] = Locator.locate(Message.FilePath, Message.FileOffset);
+      OS << getDisplayPath(Message.FilePath, StripPrefix) << ':' << Line << ':'
+         << Column << ": ";
+    }
+    OS << getLevel(Error) << ": " << Message.Message << " ["
+       << Error.DiagnosticName << "]\n";
+  }
+  OS.flush();
+}
+
+void JSONLinesDiagnosticSink::consume(StringRef Unit,
+                                      ArrayRef<ClangTidyError> Errors) {
+  for (const ClangTidyError &Error : Errors) {
+    const tooling::DiagnosticMessage &Message = Error.Message;
+    auto [Line, Column] = locate(Locator, Message);
+
+    // Replacements are grouped by file in an unordered map; sort them to keep
+    // the output stable.
+    std::vector<StringRef> FixFiles;
+    for (const auto &FileAndReplacements : Message.Fix)
+      FixFiles.push_back(FileAndReplacements.getKey());
+    llvm::sort(FixFiles);
+
+    llvm::json::OStream J(OS);
+    J.object([&] {
+      J.attribute("unit", Unit);
+      J.attribute("check", Error.DiagnosticName);
+      J.attribute("file", getDisplayPath(Message.FilePath, StripPrefix));
+      J.attribute("line", Line);
+      J.attribute("col", Column);
+      J.attribute("level", getLevel(Error));
+      J.attribute("message", Message.Message);
+      J.attributeArray("fix", [&] {
+        for (StringRef File : FixFiles) {
+          const tooling::Replacements &Replacements =
+              Message.Fix.find(File)->getValue();
+          for (const tooling::Replacement &R : Replacements)
+            J.object([&] {
+              J.attribute("file",
+                          getDisplayPath(R.getFilePath(), StripPrefix));
+              J.attribute("offset", R.getOffset());
+              J.attribute("length", R.getLength());
+              J.attribute("replacement", R.getReplacementText());
+            });
+        }
+      });
+      J.attributeArray("notes", [&] {
+        for (const tooling::DiagnosticMessage &Note : Error.Notes) {
+          auto [NoteLine, NoteColumn] = locate(Locator, Note);
+          J.object([&] {
+            J.attribute("file", getDisplayPath(Note.FilePath, StripPrefix));
+            J.attribute("line", NoteLine);
+            J.attribute("col", NoteColumn);
+            J.attribute("message", Note.Message);
+          });
+        }
+      });
+    });
+    OS << '\n';
+  }
+  OS.flush();
+}
+
+void BinaryDiagnosticSink::consume(StringRef Unit,
+                                   ArrayRef<ClangTidyError> Errors) {
+  BinaryUnit Result{Unit, {}};
+  Result.Diagnostics.reserve(Errors.size());
+  for (const ClangTidyError &Error : Errors) {
+    const tooling::DiagnosticMessage &Message = Error.Message;
+    auto [Line, Column] = locate(Locator, Message);
+    BinaryDiagnostic &D = Result.Diagnostics.emplace_back();
+    D.Check = Error.DiagnosticName;
+    D.Level = llvm::StringSwitch<BinaryLevel>(getLevel(Error))
+                  .Case("error", BinaryLevel::Error)
+                  .Case("remark", BinaryLevel::Remark)
+                  .Default(BinaryLevel::Warning);
+    D.File = getDisplayPath(Message.FilePath, StripPrefix);
+    D.Offset = Message.FileOffset;
+    D.Line = Line;
+    D.Column = Column;
+    D.Message = Message.Message;
+
+    // Sorted by file, as in the JSON Lines output.
+    std::vector<StringRef> FixFiles;
+    for (const auto &FileAndReplacements : Message.Fix)
+      FixFiles.push_back(FileAndReplacements.getKey());
+    llvm::sort(FixFiles);
+    for (StringRef File : FixFiles)
+      for (const tooling::Replacement &R : Message.Fix.find(File)->getValue())
+        D.Fixes.push_back({getDisplayPath(R.getFilePath(), StripPrefix),
+                           R.getOffset(), R.getLength(),
+                           R.getReplacementText()});
+    for (const tooling::DiagnosticMessage &Note : Error.Notes) {
+      auto [NoteLine, NoteColumn] = locate(Locator, Note);
+      D.Notes.push_back({getDisplayPath(Note.FilePath, StripPrefix),
+                         Note.FileOffset, NoteLine, NoteColumn, Note.Message});
+    }
+  }
+  writeBinaryUnit(OS, Result);
+  OS.flush();
+}
+
+void StoreDiagnosticSink::consume(StringRef Unit,
+                                  ArrayRef<ClangTidyError> Errors) {
+  std::vector<StoredFinding> Findings;
+  Findings.reserve(Errors.size());
+  for (const ClangTidyError &Error : Errors) {
+    const tooling::DiagnosticMessage &Message = Error.Message;
+    StoredFinding &Finding = Findings.emplace_back();
+    Finding.Check = Error.DiagnosticName;
+    Finding.File = getDisplayPath(Message.FilePath, StripPrefix).str();
+    Finding.Line = 0;
+    if (!Message.FilePath.empty()) {
+      Finding.Line = Locator.locate(Message.FilePath, Message.FileOffset).first;
+      Finding.Value = Locator.getTokenAt(Message.FilePath, Message.FileOffset);
+    }
+    Finding.Submission = Submission;
+  }
+  if (llvm::Error Err = Store.append(Findings))
+    llvm::errs() << "caos-batch: " << Unit
+                 << ": cannot append to the results store: "
+                 << toString(std::move(Err)) << "\n";
+  Next->consume(Unit, Errors);
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
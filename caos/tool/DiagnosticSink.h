@@ -0,0 +1,136 @@
+//===--- DiagnosticSink.h - caos-batch --------------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_DIAGNOSTICSINK_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_DIAGNOSTICSINK_H
+
+#include "../../clang-tidy/ClangTidyDiagnosticConsumer.h"
+#include "ResultStore.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <string>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+/// Maps file offsets of diagnostics back to line and column numbers.
+class LineLocator {
+public:
+  explicit LineLocator(llvm::vfs::FileSystem &FS) : FS(FS) {}
+
+  /// Returns the 1-based line and column of \p Offset in \p Path, or {0, 0} if
+  /// the file can't be read.
+  std::pair<unsigned, unsigned> locate(StringRef Path, unsigned Offset);
+
+  /// Returns the identifier or number at \p Offset in \p Path, or an empty
+  /// string if there is none.
+  std::string getTokenAt(StringRef Path, unsigned Offset);
+
+private:
+  /// Returns the contents of \p Path, or null if it can't be read.
+  const llvm::MemoryBuffer *getBuffer(StringRef Path);
+
+  llvm::vfs::FileSystem &FS;
+  std::string CachedPath;
+  std::unique_ptr<llvm::MemoryBuffer> Buffer;
+};
+
+/// Receives the findings of each analysed unit as soon as it is done, so
+/// nothing has to be kept in memory across units.
+class DiagnosticSink {
+public:
+  virtual ~DiagnosticSink() = default;
+
+  /// Called once per analysed unit (e.g. archive member) with its findings.
+  virtual void consume(StringRef Unit, ArrayRef<ClangTidyError> Errors) = 0;
+};
+
+/// Prints findings in the usual compiler format, prefixed with the unit.
+class TextDiagnosticSink : public DiagnosticSink {
+public:
+  TextDiagnosticSink(llvm::raw_ostream &OS, LineLocator &Locator,
+                     StringRef StripPrefix)
+      : OS(OS), Locator(Locator), StripPrefix(StripPrefix) {}
+
+  void consume(StringRef Unit, ArrayRef<ClangTidyError> Errors) override;
+
+private:
+  llvm::raw_ostream &OS;
+  LineLocator &Locator;
+  std::string StripPrefix;
+};
+
+/// Writes one compact JSON object per finding (JSON Lines):
+/// \code
+///   {"unit":"a/main.c","check":"caos-magic-numbers","file":"a/main.c",
+///    "line":3,"col":15,"level":"warning","message":"...","fix":[...],
+///    "notes":[...]}
+/// \endcode
+/// Output is flushed after every unit so that consumers can process results
+/// incrementally.
+class JSONLinesDiagnosticSink : public DiagnosticSink {
+public:
+  JSONLinesDiagnosticSink(llvm::raw_ostream &OS, LineLocator &Locator,
+                          StringRef StripPrefix)
+      : OS(OS), Locator(Locator), StripPrefix(StripPrefix) {}
+
+  void consume(StringRef Unit, ArrayRef<ClangTidyError> Errors) override;
+
+private:
+  llvm::raw_ostream &OS;
+  LineLocator &Locator;
+  std::string StripPrefix;
+};
+
+/// Writes the findings of each unit as a chunk of the binary format described
+/// in BinaryDiagnostics.h, flushed after every unit.
+class BinaryDiagnosticSink : public DiagnosticSink {
+public:
+  BinaryDiagnosticSink(llvm::raw_ostream &OS, LineLocator &Locator,
+                       StringRef StripPrefix)
+      : OS(OS), Locator(Locator), StripPrefix(StripPrefix) {}
+
+  void consume(StringRef Unit, ArrayRef<ClangTidyError> Errors) override;
+
+private:
+  llvm::raw_ostream &OS;
+  LineLocator &Locator;
+  std::string StripPrefix;
+};
+
+/// Appends the findings of each unit to a results store, as rows of
+/// \p Submission, and passes them on to \p Next.
+class StoreDiagnosticSink : public DiagnosticSink {
+public:
+  StoreDiagnosticSink(ResultStoreWriter &Store, LineLocator &Locator,
+                      StringRef StripPrefix, StringRef Submission,
+                      std::unique_ptr<DiagnosticSink> Next)
+      : Store(Store), Locator(Locator), StripPrefix(StripPrefix),
+        Submission(Submission), Next(std::move(Next)) {}
+
+  void consume(StringRef Unit, ArrayRef<ClangTidyError> Errors) override;
+
+private:
+  ResultStoreWriter &Store;
+  LineLocator &Locator;
+  std::string StripPrefix;
+  std::string Submission;
+  std::unique_ptr<DiagnosticSink> Next;
+};
+
+/// Returns \p Path relative to \p Prefix if it is inside it.
+StringRef getDisplayPath(StringRef Path, StringRef Prefix);
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_DIAGNOSTICSINK_H
@@ -0,0 +1,305 @@
+//===--- HeaderSnapshot.cpp - caos-batch ----------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "HeaderSnapshot.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <optional>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+// A snapshot is a header, an index of fixed-size little-endian records and
+// the paths and file contents the records point to, each followed by a NUL:
+//
+//   Magic[8] NumEntries:u32 Reserved:u32
+//   { Kind:u32 PathSize:u32 PathOffset:u64 DataOffset:u64 DataSize:u64 }...
+//
+// Offsets are from the start of the snapshot.
+static constexpr llvm::StringLiteral Magic = "CAOSHDR1";
+static constexpr size_t HeaderSize = 16;
+static constexpr size_t RecordSize = 32;
+
+namespace endian = llvm::support::endian;
+
+static llvm::Error malformed(const llvm::Twine &Message) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 "malformed header snapshot: " + Message);
+}
+
+llvm::Expected<std::unique_ptr<HeaderSnapshot>>
+HeaderSnapshot::open(StringRef Path) {
+  // Large snapshots are mapped rather than read.
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Blob =
+      llvm::MemoryBuffer::getFile(Path, /*IsText=*/false,
+                                  /*RequiresNullTerminator=*/false);
+  if (!Blob)
+    return llvm::createFileError(Path, Blob.getError());
+
+  std::unique_ptr<HeaderSnapshot> Snapshot(
+      new HeaderSnapshot(std::move(*Blob)));
+  if (llvm::Error Err = Snapshot->index())
+    return llvm::createFileError(Path, std::move(Err));
+  return std::move(Snapshot);
+}
+
+llvm::Error HeaderSnapshot::index() {
+  const StringRef Bytes = Blob->getBuffer();
+  if (Bytes.size() < HeaderSize || !Bytes.startswith(Magic))
+    return malformed("bad header");
+  const uint32_t NumEntries =
+      endian::read32le(Bytes.data() + Magic.size());
+  if ((Bytes.size() - HeaderSize) / RecordSize < NumEntries)
+    return malformed("truncated index");
+
+  // A string of the snapshot, which must be followed by a NUL.
+  auto GetString = [&Bytes](uint64_t Offset,
+                            uint64_t Size) -> std::optional<StringRef> {
+    if (Offset > Bytes.size() || Bytes.size() - Offset <= Size ||
+        Bytes[Offset + Size] != '\0')
+      return std::nullopt;
+    return Bytes.substr(Offset, Size);
+  };
+
+  Entries.reserve(NumEntries);
+  for (uint32_t I = 0; I < NumEntries; ++I) {
+    const char *Record = Bytes.data() + HeaderSize + I * RecordSize;
+    const uint32_t Kind = endian::read32le(Record);
+    if (Kind > static_cast<uint32_t>(EntryKind::Missing))
+      return malformed("bad entry kind");
+    std::optional<StringRef> Path = GetString(endian::read64le(Record + 8),
+                                              endian::read32le(Record + 4));
+    std::optional<StringRef> Data = GetString(endian::read64le(Record + 16),
+                                              endian::read64le(Record + 24));
+    if (!Path || !Data)
+      return malformed("entry out of bounds");
+    Entries.push_back({static_cast<EntryKind>(Kind), *Path, *Data});
+  }
+  return llvm::Error::success();
+}
+
+llvm::ErrorOr<llvm::vfs::Status>
+HeaderSnapshotRecorder::status(const Twine &Path) {
+  llvm::ErrorOr<llvm::vfs::Status> Status = ProxyFileSystem::status(Path);
+  record(Path, Status);
+  return Status;
+}
+
+llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>>
+HeaderSnapshotRecorder::openFileForRead(const Twine &Path) {
+  llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> File =
+      ProxyFileSystem::openFileForRead(Path);
+  if (File)
+    record(Path, (*File)->status());
+  else
+    record(Path, File.getError());
+  return File;
+}
+
+void HeaderSnapshotRecorder::record(
+    const Twine &Path, const llvm::ErrorOr<llvm::vfs::Status> &Status) {
+  llvm::SmallString<256> P;
+  Path.toVector(P);
+  // Only absolute paths, which don't depend on the working directory.
+  if (!llvm::sys::path::is_absolute(P) ||
+      llvm::none_of(Directories, [&P](const std::string &Directory) {
+        StringRef Rest = P;
+        return Rest.consume_front(Directory) &&
+               (Rest.empty() || llvm::sys::path::is_separator(Rest[0]));
+      }))
+    return;
+
+  HeaderSnapshot::EntryKind Kind;
+  if (Status)
+    Kind = Status->isDirectory() ? HeaderSnapshot::EntryKind::Directory
+                                 : HeaderSnapshot::EntryKind::File;
+  else if (Status.getError() == std::errc::no_such_file_or_directory)
+    Kind = HeaderSnapshot::EntryKind::Missing;
+  else
+    return;
+  Lookups.insert_or_assign(P, Kind);
+}
+
+// Each lookup is serialized as its kind, as a digit, and its path, followed
+// by a NUL.
+std::string HeaderSnapshotRecorder::takeLookups() {
+  std::string Serialized;
+  for (const auto &Lookup : Lookups) {
+    Serialized += static_cast<char>('0' + static_cast<int>(Lookup.second));
+    Serialized += Lookup.first();
+    Serialized += '\0';
+  }
+  Lookups.clear();
+  return Serialized;
+}
+
+void HeaderSnapshotRecorder::mergeLookups(StringRef Serialized) {
+  while (!Serialized.empty()) {
+    StringRef Lookup;
+    std::tie(Lookup, Serialized) = Serialized.split('\0');
+    if (Lookup.size() < 2 || Lookup[0] < '0' ||
+        Lookup[0] > '0' + static_cast<int>(HeaderSnapshot::EntryKind::Missing))
+      continue;
+    Lookups.insert_or_assign(
+        Lookup.drop_front(),
+        static_cast<HeaderSnapshot::EntryKind>(Lookup[0] - '0'));
+  }
+}
+
+llvm::Error HeaderSnapshotRecorder::write(StringRef Path) {
+  struct Pending {
+    HeaderSnapshot::EntryKind Kind;
+    StringRef Path;
+    std::unique_ptr<llvm::MemoryBuffer> Data;
+  };
+  std::vector<Pending> Entries;
+  for (const auto &Lookup : Lookups) {
+    Pending Entry{Lookup.second, Lookup.first(), nullptr};
+    if (Entry.Kind == HeaderSnapshot::EntryKind::File) {
+      llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Data =
+          getUnderlyingFS().getBufferForFile(Entry.Path);
+      // Leave out a file that can no longer be read, which will be looked up
+      // on the file system again.
+      if (!Data)
+        continue;
+      Entry.Data = std::move(*Data);
+    }
+    Entries.push_back(std::move(Entry));
+  }
+  // The order of the snapshot doesn't depend on the order of the lookups.
+  llvm::sort(Entries, [](const Pending &LHS, const Pending &RHS) {
+    return LHS.Path < RHS.Path;
+  });
+
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC, llvm::sys::fs::OF_None);
+  if (EC)
+    return llvm::createFileError(Path, EC);
+
+  endian::Writer Writer(OS, llvm::support::little);
+  OS << Magic;
+  Writer.write<uint32_t>(Entries.size());
+  Writer.write<uint32_t>(0);
+  uint64_t Offset = HeaderSize + Entries.size() * RecordSize;
+  for (const Pending &Entry : Entries) {
+    const StringRef Data =
+        Entry.Data ? Entry.Data->getBuffer() : StringRef("", 0);
+    Writer.write<uint32_t>(static_cast<uint32_t>(Entry.Kind));
+    Writer.write<uint32_t>(Entry.Path.size());
+    Writer.write<uint64_t>(Offset);
+    Offset += Entry.Path.size() + 1;
+    Writer.write<uint64_t>(Offset);
+    Writer.write<uint64_t>(Data.size());
+    Offset += Data.size() + 1;
+  }
+  for (const Pending &Entry : Entries) {
+    OS << Entry.Path << '\0';
+    if (Entry.Data)
+      OS << Entry.Data->getBuffer();
+    OS << '\0';
+  }
+
+  OS.close();
+  if (OS.has_error())
+    return llvm::createFileError(Path, OS.error());
+  return llvm::Error::success();
+}
+
+namespace {
+
+/// Serves the files and directories of a snapshot from an in-memory file
+/// system, reports its missing paths as such and passes the other lookups on.
+/// A directory of the snapshot lists the entries the snapshot has under it,
+/// so that iterating over it (module maps, frameworks) agrees with the
+/// lookups even when the file system has changed since.
+class SnapshotFileSystem : public llvm::vfs::ProxyFileSystem {
+public:
+  SnapshotFileSystem(const HeaderSnapshot &Snapshot,
+                     llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> FS)
+      : ProxyFileSystem(std::move(FS)),
+        Files(llvm::makeIntrusiveRefCnt<llvm::vfs::InMemoryFileSystem>()) {
+    for (const HeaderSnapshot::Entry &Entry : Snapshot.entries()) {
+      switch (Entry.Kind) {
+      case HeaderSnapshot::EntryKind::File:
+        // The contents are followed by a NUL in the mapping, as clang
+        // requires of the buffers it lexes.
+        Files->addFileNoOwn(Entry.Path, /*ModificationTime=*/0,
+                            llvm::MemoryBufferRef(Entry.Data, Entry.Path));
+        break;
+      case HeaderSnapshot::EntryKind::Directory:
+        Files->addFile(Entry.Path, /*ModificationTime=*/0,
+                       llvm::MemoryBuffer::getMemBuffer(""), std::nullopt,
+                       std::nullopt, llvm::sys::fs::file_type::directory_file);
+        break;
+      case HeaderSnapshot::EntryKind::Missing:
+        break;
+      }
+      Kinds.try_emplace(Entry.Path, Entry.Kind);
+    }
+  }
+
+  llvm::ErrorOr<llvm::vfs::Status> status(const Twine &Path) override {
+    llvm::SmallString<256> P;
+    Path.toVector(P);
+    auto It = Kinds.find(P);
+    if (It == Kinds.end())
+      return ProxyFileSystem::status(P);
+    if (It->second == HeaderSnapshot::EntryKind::Missing)
+      return std::make_error_code(std::errc::no_such_file_or_directory);
+    return Files->status(P);
+  }
+
+  llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>>
+  openFileForRead(const Twine &Path) override {
+    llvm::SmallString<256> P;
+    Path.toVector(P);
+    auto It = Kinds.find(P);
+    if (It == Kinds.end())
+      return ProxyFileSystem::openFileForRead(P);
+    if (It->second == HeaderSnapshot::EntryKind::Missing)
+      return std::make_error_code(std::errc::no_such_file_or_directory);
+    return Files->openFileForRead(P);
+  }
+
+  llvm::vfs::directory_iterator dir_begin(const Twine &Dir,
+                                          std::error_code &EC) override {
+    llvm::SmallString<256> P;
+    Dir.toVector(P);
+    auto It = Kinds.find(P);
+    if (It == Kinds.end())
+      return ProxyFileSystem::dir_begin(P, EC);
+    if (It->second == HeaderSnapshot::EntryKind::Missing) {
+      EC = std::make_error_code(std::errc::no_such_file_or_directory);
+      return {};
+    }
+    return Files->dir_begin(P, EC);
+  }
+
+private:
+  llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> Files;
+  llvm::StringMap<HeaderSnapshot::EntryKind> Kinds;
+};
+
+} // namespace
+
+llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem>
+createSnapshotFileSystem(const HeaderSnapshot &Snapshot,
+                         llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> FS) {
+  return llvm::makeIntrusiveRefCnt<SnapshotFileSystem>(Snapshot,
+                                                       std::move(FS));
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
@@ -0,0 +1,103 @@
+//===--- HeaderSnapshot.h - caos-batch --------------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_HEADERSNAPSHOT_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_HEADERSNAPSHOT_H
+
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+/// The system headers looked up by a batch, in a single file mapped into
+/// memory: the contents of the headers read, the directories that exist and
+/// the paths that were looked up without being found (most of the search of
+/// an #include <...>).
+///
+/// A first run records the lookups of clang under the system directories with
+/// \c HeaderSnapshotRecorder and writes the snapshot; the next ones serve them
+/// from \c createSnapshotFileSystem without touching the file system. Lookups
+/// the snapshot doesn't know about still go to the file system. The snapshot
+/// isn't checked against the file system, so it has to be deleted when the
+/// system headers change.
+class HeaderSnapshot {
+public:
+  enum class EntryKind : uint32_t { File, Directory, Missing };
+
+  struct Entry {
+    EntryKind Kind;
+    StringRef Path;
+    /// The contents of a file, followed by a NUL in the mapping.
+    StringRef Data;
+  };
+
+  static llvm::Expected<std::unique_ptr<HeaderSnapshot>> open(StringRef Path);
+
+  ArrayRef<Entry> entries() const { return Entries; }
+
+private:
+  explicit HeaderSnapshot(std::unique_ptr<llvm::MemoryBuffer> Blob)
+      : Blob(std::move(Blob)) {}
+
+  llvm::Error index();
+
+  std::unique_ptr<llvm::MemoryBuffer> Blob;
+  std::vector<Entry> Entries;
+};
+
+/// Passes every call to the underlying file system, recording the files,
+/// directories and missing paths looked up under \p Directories.
+class HeaderSnapshotRecorder : public llvm::vfs::ProxyFileSystem {
+public:
+  HeaderSnapshotRecorder(llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> FS,
+                         std::vector<std::string> Directories)
+      : ProxyFileSystem(std::move(FS)), Directories(std::move(Directories)) {}
+
+  llvm::ErrorOr<llvm::vfs::Status> status(const Twine &Path) override;
+  llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>>
+  openFileForRead(const Twine &Path) override;
+
+  /// Writes the snapshot of the lookups recorded so far to \p Path.
+  llvm::Error write(StringRef Path);
+
+  /// Returns the lookups recorded so far, serialized for \c mergeLookups, and
+  /// forgets them, so that worker processes can send theirs to the one
+  /// writing the snapshot.
+  std::string takeLookups();
+  /// Adds the lookups serialized by \c takeLookups to those recorded here.
+  void mergeLookups(StringRef Serialized);
+
+private:
+  void record(const Twine &Path,
+              const llvm::ErrorOr<llvm::vfs::Status> &Status);
+
+  const std::vector<std::string> Directories;
+  llvm::StringMap<HeaderSnapshot::EntryKind> Lookups;
+};
+
+/// Answers the lookups of the paths in \p Snapshot from it, and the others
+/// from \p FS.
+llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem>
+createSnapshotFileSystem(const HeaderSnapshot &Snapshot,
+                         llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> FS);
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_HEADERSNAPSHOT_H
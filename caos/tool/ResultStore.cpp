@@ -0,0 +1,325 @@
+//===--- ResultStore.cpp - caos-batch -------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "ResultStore.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <limits>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+namespace endian = llvm::support::endian;
+
+static constexpr size_t ValueSize = sizeof(uint32_t);
+
+static constexpr StoreColumn AllColumns[] = {
+    StoreColumn::Check, StoreColumn::File, StoreColumn::Line,
+    StoreColumn::Value, StoreColumn::Submission};
+
+StringRef getColumnName(StoreColumn Column) {
+  switch (Column) {
+  case StoreColumn::Check:
+    return "check";
+  case StoreColumn::File:
+    return "file";
+  case StoreColumn::Line:
+    return "line";
+  case StoreColumn::Value:
+    return "value";
+  case StoreColumn::Submission:
+    return "submission";
+  }
+  llvm_unreachable("unknown column");
+}
+
+std::optional<StoreColumn> getColumnByName(StringRef Name) {
+  return llvm::StringSwitch<std::optional<StoreColumn>>(Name)
+      .Case("check", StoreColumn::Check)
+      .Case("file", StoreColumn::File)
+      .Case("line", StoreColumn::Line)
+      .Case("value", StoreColumn::Value)
+      .Case("submission", StoreColumn::Submission)
+      .Default(std::nullopt);
+}
+
+static bool hasDictionary(StoreColumn Column) {
+  return Column != StoreColumn::Line;
+}
+
+static std::string getPath(StringRef Directory, StoreColumn Column,
+                           StringRef Extension) {
+  llvm::SmallString<256> Path(Directory);
+  llvm::sys::path::append(Path, getColumnName(Column) + Extension);
+  return std::string(Path);
+}
+
+static std::string getColumnPath(StringRef Directory, StoreColumn Column) {
+  return getPath(Directory, Column, ".col");
+}
+
+static std::string getDictionaryPath(StringRef Directory,
+                                     StoreColumn Column) {
+  return getPath(Directory, Column, ".dict");
+}
+
+// Returns the size of Path, which is 0 if it doesn't exist yet.
+static llvm::Expected<uint64_t> getFileSize(const std::string &Path) {
+  uint64_t Size;
+  if (std::error_code EC = llvm::sys::fs::file_size(Path, Size)) {
+    if (EC == std::errc::no_such_file_or_directory)
+      return 0;
+    return llvm::createFileError(Path, EC);
+  }
+  return Size;
+}
+
+static llvm::Error truncate(const std::string &Path, uint64_t Size) {
+  int FD;
+  if (std::error_code EC = llvm::sys::fs::openFileForWrite(
+          Path, FD, llvm::sys::fs::CD_OpenExisting, llvm::sys::fs::OF_None))
+    return llvm::createFileError(Path, EC);
+  std::error_code EC = llvm::sys::fs::resize_file(FD, Size);
+  llvm::sys::Process::SafelyCloseFileDescriptor(FD);
+  if (EC)
+    return llvm::createFileError(Path, EC);
+  return llvm::Error::success();
+}
+
+static llvm::Error appendTo(const std::string &Path, StringRef Data) {
+  if (Data.empty())
+    return llvm::Error::success();
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC, llvm::sys::fs::OF_Append);
+  if (EC)
+    return llvm::createFileError(Path, EC);
+  OS << Data;
+  OS.close();
+  if (OS.has_error())
+    return llvm::createFileError(Path, OS.error());
+  return llvm::Error::success();
+}
+
+// Calls Callback on each complete entry of a dictionary, in order, and
+// returns the size they take up.
+template <typename CallbackT>
+static uint64_t forEachEntry(StringRef Data, CallbackT Callback) {
+  uint64_t Size = 0;
+  while (Data.size() - Size >= ValueSize) {
+    const uint32_t Length = endian::read32le(Data.data() + Size);
+    if (Data.size() - Size - ValueSize < Length)
+      break;
+    Callback(Data.substr(Size + ValueSize, Length));
+    Size += ValueSize + Length;
+  }
+  return Size;
+}
+
+llvm::Expected<std::unique_ptr<ResultStoreWriter>>
+ResultStoreWriter::open(StringRef Directory) {
+  if (std::error_code EC = llvm::sys::fs::create_directories(Directory))
+    return llvm::createFileError(Directory, EC);
+  return std::unique_ptr<ResultStoreWriter>(new ResultStoreWriter(Directory));
+}
+
+llvm::Error ResultStoreWriter::append(ArrayRef<StoredFinding> Findings) {
+  if (Findings.empty())
+    return llvm::Error::success();
+
+  llvm::SmallString<256> LockPath(Directory);
+  llvm::sys::path::append(LockPath, "lock");
+  int LockFD;
+  if (std::error_code EC = llvm::sys::fs::openFileForReadWrite(
+          LockPath, LockFD, llvm::sys::fs::CD_OpenAlways,
+          llvm::sys::fs::OF_None))
+    return llvm::createFileError(LockPath, EC);
+  if (std::error_code EC = llvm::sys::fs::lockFile(LockFD)) {
+    llvm::sys::Process::SafelyCloseFileDescriptor(LockFD);
+    return llvm::createFileError(LockPath, EC);
+  }
+
+  llvm::Error Err = appendLocked(Findings);
+  // What is known of the dictionaries may not match the files any more.
+  if (Err)
+    Dictionaries = {};
+
+  llvm::sys::fs::unlockFile(LockFD);
+  llvm::sys::Process::SafelyCloseFileDescriptor(LockFD);
+  return Err;
+}
+
+llvm::Error
+ResultStoreWriter::appendLocked(ArrayRef<StoredFinding> Findings) {
+  // Drop what an append that didn't finish left past the complete rows.
+  uint64_t NumRows = std::numeric_limits<uint64_t>::max();
+  std::array<uint64_t, NumStoreColumns> Sizes;
+  for (StoreColumn Column : AllColumns) {
+    llvm::Expected<uint64_t> Size =
+        getFileSize(getColumnPath(Directory, Column));
+    if (!Size)
+      return Size.takeError();
+    Sizes[static_cast<size_t>(Column)] = *Size;
+    NumRows = std::min(NumRows, *Size / ValueSize);
+  }
+  for (StoreColumn Column : AllColumns)
+    if (Sizes[static_cast<size_t>(Column)] != NumRows * ValueSize)
+      if (llvm::Error Err =
+              truncate(getColumnPath(Directory, Column), NumRows * ValueSize))
+        return Err;
+
+  // Other batches may have added strings since the last append.
+  for (StoreColumn Column : AllColumns)
+    if (hasDictionary(Column))
+      if (llvm::Error Err = readNewEntries(Column))
+        return Err;
+
+  std::array<std::string, NumStoreColumns> NewEntries;
+  std::array<std::string, NumStoreColumns> NewValues;
+  auto Add = [&](StoreColumn Column, uint32_t Value) {
+    char Bytes[ValueSize];
+    endian::write32le(Bytes, Value);
+    NewValues[static_cast<size_t>(Column)].append(Bytes, ValueSize);
+  };
+  auto AddString = [&](StoreColumn Column, StringRef S) {
+    Dictionary &D = Dictionaries[static_cast<size_t>(Column)];
+    auto [It, Inserted] = D.Ids.try_emplace(S, D.NumEntries);
+    if (Inserted) {
+      ++D.NumEntries;
+      std::string &Entries = NewEntries[static_cast<size_t>(Column)];
+      char Bytes[ValueSize];
+      endian::write32le(Bytes, S.size());
+      Entries.append(Bytes, ValueSize);
+      Entries.append(S.begin(), S.end());
+    }
+    Add(Column, It->second);
+  };
+  for (const StoredFinding &Finding : Findings) {
+    AddString(StoreColumn::Check, Finding.Check);
+    AddString(StoreColumn::File, Finding.File);
+    Add(StoreColumn::Line, Finding.Line);
+    AddString(StoreColumn::Value, Finding.Value);
+    AddString(StoreColumn::Submission, Finding.Submission);
+  }
+
+  // The dictionaries first, so that the rows never refer to missing strings.
+  for (StoreColumn Column : AllColumns) {
+    const std::string &Entries = NewEntries[static_cast<size_t>(Column)];
+    if (llvm::Error Err =
+            appendTo(getDictionaryPath(Directory, Column), Entries))
+      return Err;
+    Dictionaries[static_cast<size_t>(Column)].Size += Entries.size();
+  }
+  for (StoreColumn Column : AllColumns)
+    if (llvm::Error Err = appendTo(getColumnPath(Directory, Column),
+                                   NewValues[static_cast<size_t>(Column)]))
+      return Err;
+  return llvm::Error::success();
+}
+
+llvm::Error ResultStoreWriter::readNewEntries(StoreColumn Column) {
+  Dictionary &D = Dictionaries[static_cast<size_t>(Column)];
+  const std::string Path = getDictionaryPath(Directory, Column);
+  llvm::Expected<uint64_t> Size = getFileSize(Path);
+  if (!Size)
+    return Size.takeError();
+  // The store has been replaced under us.
+  if (*Size < D.Size)
+    D = Dictionary();
+  if (*Size == D.Size)
+    return llvm::Error::success();
+
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Tail =
+      llvm::MemoryBuffer::getFileSlice(Path, *Size - D.Size, D.Size);
+  if (!Tail)
+    return llvm::createFileError(Path, Tail.getError());
+  const uint64_t Read = forEachEntry((*Tail)->getBuffer(), [&D](StringRef S) {
+    D.Ids.try_emplace(S, D.NumEntries++);
+  });
+  D.Size += Read;
+  // A partial entry, from an append that didn't finish.
+  if (D.Size != *Size)
+    return truncate(Path, D.Size);
+  return llvm::Error::success();
+}
+
+llvm::Expected<std::unique_ptr<ResultStoreReader>>
+ResultStoreReader::load(StringRef Directory) {
+  if (!llvm::sys::fs::is_directory(Directory))
+    return llvm::createFileError(
+        Directory, std::make_error_code(std::errc::no_such_file_or_directory));
+
+  std::unique_ptr<ResultStoreReader> Reader(new ResultStoreReader());
+  // A missing column is an empty one: nothing has been appended yet.
+  auto Map = [](const std::string &Path,
+                std::unique_ptr<llvm::MemoryBuffer> &Buffer) -> llvm::Error {
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> File =
+        llvm::MemoryBuffer::getFile(Path, /*IsText=*/false,
+                                    /*RequiresNullTerminator=*/false);
+    if (File)
+      Buffer = std::move(*File);
+    else if (File.getError() != std::errc::no_such_file_or_directory)
+      return llvm::createFileError(Path, File.getError());
+    return llvm::Error::success();
+  };
+
+  Reader->NumRows = std::numeric_limits<size_t>::max();
+  for (StoreColumn Column : AllColumns) {
+    const size_t I = static_cast<size_t>(Column);
+    if (llvm::Error Err =
+            Map(getColumnPath(Directory, Column), Reader->Columns[I]))
+      return std::move(Err);
+    Reader->NumRows = std::min<size_t>(
+        Reader->NumRows,
+        Reader->Columns[I] ? Reader->Columns[I]->getBufferSize() / ValueSize
+                           : 0);
+    if (!hasDictionary(Column))
+      continue;
+    if (llvm::Error Err = Map(getDictionaryPath(Directory, Column),
+                              Reader->DictionaryFiles[I]))
+      return std::move(Err);
+    if (Reader->DictionaryFiles[I])
+      forEachEntry(Reader->DictionaryFiles[I]->getBuffer(),
+                   [&Strings = Reader->Dictionaries[I]](StringRef S) {
+                     Strings.push_back(S);
+                   });
+  }
+
+  // Every value must refer to a string, or the store is not one we wrote.
+  for (StoreColumn Column : AllColumns) {
+    if (!hasDictionary(Column))
+      continue;
+    const size_t NumStrings = Reader->dictionary(Column).size();
+    for (Value V : Reader->column(Column))
+      if (V >= NumStrings)
+        return llvm::createFileError(
+            getColumnPath(Directory, Column),
+            llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                    "value out of the dictionary"));
+  }
+  return std::move(Reader);
+}
+
+ArrayRef<ResultStoreReader::Value>
+ResultStoreReader::column(StoreColumn Column) const {
+  const std::unique_ptr<llvm::MemoryBuffer> &Buffer =
+      Columns[static_cast<size_t>(Column)];
+  if (!Buffer || NumRows == 0)
+    return {};
+  return ArrayRef<Value>(
+      reinterpret_cast<const Value *>(Buffer->getBufferStart()), NumRows);
+}
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
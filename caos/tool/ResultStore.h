@@ -0,0 +1,125 @@
+//===--- ResultStore.h - caos-batch -----------------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_RESULTSTORE_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_RESULTSTORE_H
+
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <array>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+/// A column of a results store (see \c ResultStoreWriter).
+enum class StoreColumn { Check, File, Line, Value, Submission };
+
+constexpr size_t NumStoreColumns = 5;
+
+/// Returns the name of \p Column, which is also the stem of its files.
+StringRef getColumnName(StoreColumn Column);
+
+/// Returns the column named \p Name, if any.
+std::optional<StoreColumn> getColumnByName(StringRef Name);
+
+/// A row of the store.
+struct StoredFinding {
+  std::string Check;
+  std::string File;
+  unsigned Line;
+  /// The literal or identifier the finding is about, if any.
+  std::string Value;
+  /// Identifies the batch, e.g. the assignment it grades.
+  std::string Submission;
+};
+
+/// The findings of every batch run with the same store directory, kept for
+/// queries across batches (e.g. the magic numbers per student and
+/// assignment).
+///
+/// Each column is a file of little-endian 32-bit values, one per finding:
+/// the line directly, and the other columns as indices into a dictionary
+/// file of the distinct strings of the column, each a 32-bit length and the
+/// bytes. A query maps the columns it needs and scans them as arrays, without
+/// parsing anything but the dictionaries.
+///
+/// Batches only ever append, under a lock, so several can share a store. The
+/// dictionaries are written before the columns and a reader only sees the
+/// rows present in every column, so a batch that dies half-way through an
+/// append leaves a store that reads as if it never started it.
+///
+/// This class appends findings to a store, creating it if needed.
+class ResultStoreWriter {
+public:
+  static llvm::Expected<std::unique_ptr<ResultStoreWriter>>
+  open(StringRef Directory);
+
+  /// Appends \p Findings as one step: either all of them are stored or, if
+  /// the process dies meanwhile, none.
+  llvm::Error append(ArrayRef<StoredFinding> Findings);
+
+private:
+  /// The part of a dictionary file this writer has read.
+  struct Dictionary {
+    llvm::StringMap<uint32_t> Ids;
+    uint32_t NumEntries = 0;
+    uint64_t Size = 0;
+  };
+
+  explicit ResultStoreWriter(StringRef Directory) : Directory(Directory) {}
+
+  llvm::Error appendLocked(ArrayRef<StoredFinding> Findings);
+  llvm::Error readNewEntries(StoreColumn Column);
+
+  std::string Directory;
+  std::array<Dictionary, NumStoreColumns> Dictionaries;
+};
+
+/// A read-only view of the rows of a store at the time it was loaded.
+class ResultStoreReader {
+public:
+  using Value = llvm::support::ulittle32_t;
+
+  static llvm::Expected<std::unique_ptr<ResultStoreReader>>
+  load(StringRef Directory);
+
+  size_t size() const { return NumRows; }
+
+  /// The values of \p Column, one per row: a line, or an index into the
+  /// dictionary of the column.
+  ArrayRef<Value> column(StoreColumn Column) const;
+
+  /// The distinct strings of \p Column, which must not be the line.
+  ArrayRef<StringRef> dictionary(StoreColumn Column) const {
+    return Dictionaries[static_cast<size_t>(Column)];
+  }
+
+private:
+  ResultStoreReader() = default;
+
+  size_t NumRows = 0;
+  std::array<std::unique_ptr<llvm::MemoryBuffer>, NumStoreColumns> Columns;
+  std::array<std::unique_ptr<llvm::MemoryBuffer>, NumStoreColumns>
+      DictionaryFiles;
+  std::array<std::vector<StringRef>, NumStoreColumns> Dictionaries;
+};
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_RESULTSTORE_H
@@ -0,0 +1,333 @@
+//===--- ShardCoordinator.cpp - caos-batch --------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "ShardCoordinator.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <vector>
+
+#ifdef LLVM_ON_UNIX
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+#ifdef LLVM_ON_UNIX
+
+static llvm::Error errnoError(const llvm::Twine &What) {
+  return llvm::createStringError(std::error_code(errno, std::generic_category()),
+                                 What + ": " + std::strerror(errno));
+}
+
+// Writes all of Data to the socket FD. MSG_NOSIGNAL turns the SIGPIPE of a
+// peer that died into an error.
+static bool sendAll(int FD, llvm::StringRef Data) {
+  while (!Data.empty()) {
+    const ssize_t Sent = ::send(FD, Data.data(), Data.size(), MSG_NOSIGNAL);
+    if (Sent < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    Data = Data.drop_front(Sent);
+  }
+  return true;
+}
+
+// Appends what can be read from FD to Buffer. Returns false at the end of the
+// stream or on error.
+static bool receive(int FD, std::string &Buffer) {
+  char Chunk[64 * 1024];
+  for (;;) {
+    const ssize_t Received = ::read(FD, Chunk, sizeof(Chunk));
+    if (Received < 0 && errno == EINTR)
+      continue;
+    if (Received <= 0)
+      return false;
+    Buffer.append(Chunk, Received);
+    return true;
+  }
+}
+
+// The body of a worker: runs the jobs it is sent until the coordinator closes
+// its end of the socket.
+[[noreturn]] static void
+runWorker(int FD, llvm::function_ref<ShardResult(size_t)> Work) {
+  std::string Buffer;
+  for (;;) {
+    size_t LineEnd;
+    while ((LineEnd = Buffer.find('\n')) == std::string::npos) {
+      if (!receive(FD, Buffer))
+        std::exit(0);
+    }
+    size_t Index;
+    if (llvm::StringRef(Buffer).take_front(LineEnd).getAsInteger(10, Index))
+      ::_exit(1);
+    Buffer.erase(0, LineEnd + 1);
+
+    const ShardResult Result = Work(Index);
+    std::string Header;
+    llvm::raw_string_ostream(Header)
+        << Index << ' ' << Result.UnitsWithErrors << ' '
+        << llvm::format("%.3f", Result.Milliseconds) << ' '
+        << Result.Output.size() << ' ' << Result.Statistics.size() << ' '
+        << Result.HeaderLookups.size() << '\n';
+    if (!sendAll(FD, Header) || !sendAll(FD, Result.Output) ||
+        !sendAll(FD, Result.Statistics) || !sendAll(FD, Result.HeaderLookups))
+      ::_exit(1);
+  }
+}
+
+namespace {
+
+struct Worker {
+  pid_t Pid = -1;
+  int FD = -1;
+  /// What has been received of the result of Job.
+  std::string Buffer;
+  std::optional<size_t> Job;
+
+  bool isRunning() const { return FD >= 0; }
+};
+
+enum class Receipt { Incomplete, Complete, Malformed };
+
+} // namespace
+
+// Takes the result of Job from the front of Buffer, once it has all been
+// received.
+static Receipt takeResult(std::string &Buffer, size_t Job,
+                          ShardResult &Result) {
+  const size_t LineEnd = Buffer.find('\n');
+  if (LineEnd == std::string::npos)
+    return Receipt::Incomplete;
+  llvm::SmallVector<llvm::StringRef, 6> Fields;
+  llvm::StringRef(Buffer).take_front(LineEnd).split(Fields, ' ');
+  size_t Index, OutputSize, StatisticsSize, LookupsSize;
+  if (Fields.size() != 6 || Fields[0].getAsInteger(10, Index) ||
+      Index != Job || Fields[1].getAsInteger(10, Result.UnitsWithErrors) ||
+      Fields[2].getAsDouble(Result.Milliseconds) ||
+      Fields[3].getAsInteger(10, OutputSize) ||
+      Fields[4].getAsInteger(10, StatisticsSize) ||
+      Fields[5].getAsInteger(10, LookupsSize))
+    return Receipt::Malformed;
+  if (Buffer.size() - LineEnd - 1 < OutputSize + StatisticsSize + LookupsSize)
+    return Receipt::Incomplete;
+
+  size_t Offset = LineEnd + 1;
+  Result.Output = Buffer.substr(Offset, OutputSize);
+  Offset += OutputSize;
+  Result.Statistics = Buffer.substr(Offset, StatisticsSize);
+  Offset += StatisticsSize;
+  Result.HeaderLookups = Buffer.substr(Offset, LookupsSize);
+  Buffer.erase(0, Offset + LookupsSize);
+  return Receipt::Complete;
+}
+
+// Closes the socket of W, which makes a live worker exit, and reaps it.
+// Returns a description of how it ended if it didn't exit cleanly.
+static std::optional<std::string> stop(Worker &W) {
+  ::close(W.FD);
+  int Status = 0;
+  while (::waitpid(W.Pid, &Status, 0) < 0 && errno == EINTR)
+    ;
+  std::optional<std::string> Failure;
+  if (WIFSIGNALED(Status))
+    Failure = "killed by signal " + std::to_string(WTERMSIG(Status));
+  else if (WIFEXITED(Status) && WEXITSTATUS(Status) != 0)
+    Failure = "exited with status " + std::to_string(WEXITSTATUS(Status));
+  W = Worker();
+  return Failure;
+}
+
+llvm::Error runShards(size_t NumJobs, unsigned NumWorkers, unsigned MaxRetries,
+                      llvm::function_ref<ShardResult(size_t)> Work,
+                      llvm::function_ref<void(size_t, const ShardResult &)>
+                          Consume) {
+  std::vector<Worker> Workers(
+      std::max<size_t>(1, std::min<size_t>(NumWorkers, NumJobs)));
+  std::deque<size_t> Pending(NumJobs);
+  std::iota(Pending.begin(), Pending.end(), 0);
+  std::vector<unsigned> Attempts(NumJobs, 0);
+  // Results that can't be consumed until the ones before them are.
+  std::map<size_t, ShardResult> Done;
+  size_t NextToConsume = 0;
+
+  auto Spawn = [&](unsigned Slot) -> llvm::Error {
+    int FDs[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, FDs) != 0)
+      return errnoError("cannot create a worker socket");
+    const pid_t Pid = ::fork();
+    if (Pid < 0) {
+      llvm::Error Err = errnoError("cannot fork a worker");
+      ::close(FDs[0]);
+      ::close(FDs[1]);
+      return Err;
+    }
+    if (Pid == 0) {
+      // The worker must not hold the sockets of the others, or they would
+      // not see the coordinator close them.
+      ::close(FDs[0]);
+      for (const Worker &Other : Workers)
+        if (Other.isRunning())
+          ::close(Other.FD);
+      runWorker(FDs[1], Work);
+    }
+    ::close(FDs[1]);
+    Workers[Slot].Pid = Pid;
+    Workers[Slot].FD = FDs[0];
+    return llvm::Error::success();
+  };
+
+  // Gives W the next pending job, or stops it if there is none. Returns false
+  // if W turns out to be dead.
+  auto Dispatch = [&](Worker &W) {
+    if (Pending.empty()) {
+      if (std::optional<std::string> Failure = stop(W))
+        llvm::errs() << "caos-batch: idle worker " << *Failure << "\n";
+      return true;
+    }
+    const size_t Job = Pending.front();
+    if (!sendAll(W.FD, std::to_string(Job) + "\n"))
+      return false;
+    Pending.pop_front();
+    W.Job = Job;
+    ++Attempts[Job];
+    return true;
+  };
+
+  // Reaps the dead worker in Slot, handing its job out again or failing it,
+  // and replaces it if there is work left.
+  auto Replace = [&](unsigned Slot) -> llvm::Error {
+    Worker &W = Workers[Slot];
+    const pid_t Pid = W.Pid;
+    const std::optional<size_t> Job = W.Job;
+    const std::optional<std::string> Failure = stop(W);
+    llvm::errs() << "caos-batch: worker " << Pid << " "
+                 << Failure.value_or("exited unexpectedly");
+    if (Job && Attempts[*Job] <= MaxRetries) {
+      llvm::errs() << "; retrying its job\n";
+      Pending.push_front(*Job);
+    } else {
+      llvm::errs() << "\n";
+      if (Job)
+        Done[*Job].Failed = true;
+    }
+    // A worker that dies before taking a job is not replaced, so that
+    // workers which cannot start don't fork forever.
+    if (!Job || Pending.empty())
+      return llvm::Error::success();
+    if (llvm::Error Err = Spawn(Slot))
+      return Err;
+    if (!Dispatch(W)) {
+      // The replacement died before taking the job, and is not replaced.
+      stop(W);
+      llvm::errs() << "caos-batch: worker exited before taking a job\n";
+    }
+    return llvm::Error::success();
+  };
+
+  for (unsigned Slot = 0; Slot < Workers.size(); ++Slot) {
+    if (llvm::Error Err = Spawn(Slot))
+      return Err;
+    if (!Dispatch(Workers[Slot]))
+      if (llvm::Error Err = Replace(Slot))
+        return Err;
+  }
+
+  std::vector<pollfd> PollFDs;
+  std::vector<unsigned> PollSlots;
+  while (NextToConsume < NumJobs) {
+    PollFDs.clear();
+    PollSlots.clear();
+    for (unsigned Slot = 0; Slot < Workers.size(); ++Slot) {
+      if (Workers[Slot].isRunning() && Workers[Slot].Job) {
+        PollFDs.push_back({Workers[Slot].FD, POLLIN, 0});
+        PollSlots.push_back(Slot);
+      }
+    }
+    if (PollFDs.empty())
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "no worker left to run the batch");
+    if (::poll(PollFDs.data(), PollFDs.size(), /*timeout=*/-1) < 0) {
+      if (errno == EINTR)
+        continue;
+      return errnoError("cannot wait for the workers");
+    }
+
+    for (size_t I = 0; I < PollFDs.size(); ++I) {
+      if (PollFDs[I].revents == 0)
+        continue;
+      const unsigned Slot = PollSlots[I];
+      Worker &W = Workers[Slot];
+      bool Alive = receive(W.FD, W.Buffer);
+      ShardResult Result;
+      switch (takeResult(W.Buffer, *W.Job, Result)) {
+      case Receipt::Incomplete:
+        break;
+      case Receipt::Complete:
+        Done[*W.Job] = std::move(Result);
+        W.Job.reset();
+        Alive = Dispatch(W);
+        break;
+      case Receipt::Malformed:
+        ::kill(W.Pid, SIGKILL);
+        Alive = false;
+        break;
+      }
+      if (!Alive && W.isRunning())
+        if (llvm::Error Err = Replace(Slot))
+          return Err;
+    }
+
+    for (auto It = Done.begin();
+         It != Done.end() && It->first == NextToConsume;
+         It = Done.erase(It), ++NextToConsume)
+      Consume(It->first, It->second);
+  }
+
+  for (Worker &W : Workers)
+    if (W.isRunning())
+      stop(W);
+  return llvm::Error::success();
+}
+
+#else
+
+llvm::Error runShards(size_t, unsigned, unsigned,
+                      llvm::function_ref<ShardResult(size_t)>,
+                      llvm::function_ref<void(size_t, const ShardResult &)>) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 "worker processes need a POSIX system");
+}
+
+#endif
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
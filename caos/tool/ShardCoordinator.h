@@ -0,0 +1,62 @@
+//===--- ShardCoordinator.h - caos-batch ------------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_SHARDCOORDINATOR_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_SHARDCOORDINATOR_H
+
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/Support/Error.h"
+#include <string>
+
+namespace clang {
+namespace tidy {
+namespace caos {
+
+/// What a worker sends back for a job.
+struct ShardResult {
+  /// The report of the job, in the output format of the batch.
+  std::string Output;
+  /// The statistics totals of the checks for the job, as returned by
+  /// \c takeStatisticsTotals.
+  std::string Statistics;
+  /// The system header lookups recorded for the job, as returned by
+  /// \c HeaderSnapshotRecorder::takeLookups.
+  std::string HeaderLookups;
+  unsigned UnitsWithErrors = 0;
+  double Milliseconds = 0;
+  /// Set by the coordinator when every worker that took the job died.
+  bool Failed = false;
+};
+
+/// Runs jobs 0 to \p NumJobs - 1 in \p NumWorkers worker processes forked
+/// from this one, which then acts as their coordinator.
+///
+/// Each worker is connected to the coordinator by a socket pair over which it
+/// receives the index of a job ("<index>\n"), runs \p Work on it and sends
+/// back "<index> <units with errors> <milliseconds> <output size> <statistics
+/// size> <header lookups size>\n<output><statistics><header lookups>". Jobs
+/// are handed out one at a time to whichever worker is free, so a worker that
+/// drew long jobs never holds up the others. A worker that dies is replaced
+/// and its job handed out again, up to \p MaxRetries times, after which the
+/// job is reported as failed. \p Consume receives the results in job order,
+/// whichever order the workers finish in, so the report is the same as with a
+/// single process.
+///
+/// Workers are forked, so they inherit everything the coordinator has set up
+/// (options, archive mapping, compilation database) without any of it being
+/// serialized; the coordinator must not have started any threads.
+llvm::Error runShards(size_t NumJobs, unsigned NumWorkers, unsigned MaxRetries,
+                      llvm::function_ref<ShardResult(size_t)> Work,
+                      llvm::function_ref<void(size_t, const ShardResult &)>
+                          Consume);
+
+} // namespace caos
+} // namespace tidy
+} // namespace clang
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_TIDY_CAOS_SHARDCOORDINATOR_H
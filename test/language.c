@@ -0,0 +1,24 @@
+// The checks run their C instantiation on this file and the instantiation for
+// any language on language.cpp, its C++ counterpart. Both are checked with
+//   {caos-identifier-naming.StructCase: CamelCase,
+//    caos-identifier-naming.TypedefCase: CamelCase,
+//    caos-identifier-naming.EnumConstantCase: UPPER_CASE}
+
+const int limit = 10;  // should trigger a warning ("const" is not a compile-time constant in C)
+
+enum { MAX_POINTS = 64 };  // enumerators are compile-time constants
+
+enum { bad_enumerator = 5 };  // should trigger a warning (bad case)
+
+typedef int bad_typedef;  // should trigger a warning (bad case)
+
+struct bad_point {  // should trigger a warning (bad case)
+    int x;
+    int y;
+};
+
+int main() {
+    struct bad_point origin = { 0, 0 };
+    bad_typedef area = limit * 42;  // should trigger a warning (magic number)
+    return origin.x + area + MAX_POINTS;
+}
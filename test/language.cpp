@@ -0,0 +1,46 @@
+// The C++ counterpart of language.c, checked with the same options and
+//   {caos-identifier-naming.NamespaceCase: lower_case,
+//    caos-identifier-naming.ClassCase: CamelCase,
+//    caos-identifier-naming.MethodCase: camelBack,
+//    caos-identifier-naming.TypeAliasCase: CamelCase,
+//    caos-identifier-naming.TemplateParameterCase: CamelCase}
+// for the kinds of names that only C++ has.
+
+const int limit = 10;  // should not trigger a warning ("const" is a compile-time constant in C++)
+
+enum { MAX_POINTS = 64 };  // enumerators are compile-time constants
+
+enum { bad_enumerator = 5 };  // should trigger a warning (bad case)
+
+typedef int bad_typedef;  // should trigger a warning (bad case)
+
+struct bad_point {  // should trigger a warning (bad case)
+    int x;
+    int y;
+};
+
+namespace BadNamespace {  // should trigger a warning (bad case)
+
+using bad_alias = int;  // should trigger a warning (bad case)
+
+class bad_shape {  // should trigger a warning (bad case)
+public:
+    int BadArea() const { return Width * 42; }  // should trigger warnings (bad case, magic number)
+
+private:
+    int Width = 0;
+};
+
+template <typename bad_param>  // should trigger a warning (bad case)
+struct Box {
+    bad_param Value;
+};
+
+}  // namespace BadNamespace
+
+int main() {
+    bad_point origin = { 0, 0 };
+    bad_typedef area = limit * 42;  // should trigger a warning (magic number)
+    BadNamespace::Box<BadNamespace::bad_alias> box = { area };
+    return origin.x + box.Value + MAX_POINTS + BadNamespace::bad_shape().BadArea();
+}
@@ -0,0 +1,17 @@
+// Checked with a line filter of lines 10 to 14 of this file:
+//   -line-filter='[{"name":"line_filter.c","lines":[[10,14]]}]'
+// Findings on the other lines are neither reported nor analysed.
+
+struct bad_before {  // should not trigger a warning (outside the filter)
+    int x;
+};
+
+int main() {
+    int inside = 11;  // should trigger a warning (magic number)
+    struct bad_inside {  // should trigger a warning (bad case)
+        int x;
+    } value = { 0 };
+    int last = 12;  // should trigger a warning (magic number)
+    int outside = 13;  // should not trigger a warning (outside the filter)
+    return inside + value.x + last + outside;
+}
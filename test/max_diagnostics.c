@@ -0,0 +1,17 @@
+// Checked with MaxDiagnosticsPerFile: 1, each check reports its first finding
+// in the file and skips the rest.
+
+struct bad_first {  // should trigger a warning (bad case, first finding of the check)
+    int x;
+};
+
+struct bad_second {  // should not trigger a warning (past the cap)
+    int x;
+};
+
+int main() {
+    int skipped = 11;  // NOLINT: suppressed findings don't count towards the cap
+    int first = 12;  // should trigger a warning (magic number, first finding of the check)
+    int second = 13;  // should not trigger a warning (past the cap)
+    return skipped + first + second;
+}
@@ -0,0 +1,67 @@
+// Suppression comments are looked up by the checks before they analyse a
+// finding; they must suppress exactly what clang-tidy itself suppresses.
+
+struct bad_plain {  // NOLINT
+    int x;
+};
+
+struct bad_named {  // NOLINT(caos-identifier-naming)
+    int x;
+};
+
+struct bad_glob {  // NOLINT(caos-*)
+    int x;
+};
+
+struct bad_spaced {  // NOLINT( caos-magic-numbers , caos-identifier-naming )
+    int x;
+};
+
+struct bad_other {  // NOLINT(caos-magic-numbers): should trigger a warning (bad case, other check)
+    int x;
+};
+
+struct bad_unrelated {  // NOLINT(readability-*): should trigger a warning (bad case, other check)
+    int x;
+};
+
+struct bad_typo {  // NOLINTS: should trigger a warning (bad case, not a directive)
+    int x;
+};
+
+int main() {
+    int a = 11;  // NOLINT
+    int b = 12;  // NOLINT(caos-magic-numbers)
+    int c = 13;  // NOLINT(caos-identifier-naming): should trigger a warning (magic number, other check)
+    int d = 14;  // NOLINT(caos-*,-caos-magic-numbers): negative globs are ignored, so no warning
+
+    // NOLINTNEXTLINE
+    int e = 15;
+    // NOLINTNEXTLINE(caos-magic-numbers)
+    int f = 16;
+    // NOLINTNEXTLINE(caos-identifier-naming)
+    int g = 17;  // should trigger a warning (magic number, other check)
+    // NOLINTNEXTLINE
+
+    int h = 18;  // should trigger a warning (magic number, the next-line comment is two lines up)
+
+    // NOLINTBEGIN
+    int i = 19;
+    int j = 20;
+    // NOLINTEND
+    int k = 21;  // should trigger a warning (magic number, after the block)
+
+    // NOLINTBEGIN(caos-magic-numbers)
+    int l = 22;
+    // NOLINTBEGIN(caos-identifier-naming)
+    int m = 23;  // nested blocks: suppressed by the outer one
+    // NOLINTEND(caos-identifier-naming)
+    int n = 24;
+    // NOLINTEND(caos-magic-numbers)
+
+    // NOLINTBEGIN(caos-identifier-naming)
+    int o = 25;  // should trigger a warning (magic number, other check)
+    // NOLINTEND(caos-identifier-naming)
+
+    return a + b + c + d + e + f + g + h + i + j + k + l + m + n + o;
+}
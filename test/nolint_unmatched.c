@@ -0,0 +1,24 @@
+// A file with unmatched suppression blocks: clang-tidy reports each unmatched
+// begin or end comment as an error and still honours the blocks that do
+// match. The checks analyse everything in such a file and leave the
+// suppression to clang-tidy, so the output is the same.
+
+int main() {
+    // NOLINTBEGIN(caos-magic-numbers)
+    int a = 11;  // suppressed: the block matches
+    // NOLINTEND(caos-magic-numbers)
+
+    // NOLINTBEGIN(caos-magic-numbers)
+    int b = 12;  // should trigger a warning (magic number, the block is closed for other checks)
+    // NOLINTEND(caos-*)
+
+    int c = 13;  // should trigger a warning (magic number)
+
+    // NOLINTEND
+    int d = 14;  // should trigger a warning (magic number, the end comment matches no begin)
+
+    // NOLINTBEGIN
+    int e = 15;  // should trigger a warning (magic number, the begin comment is never ended)
+
+    return a + b + c + d + e;
+}
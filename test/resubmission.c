@@ -0,0 +1,29 @@
+/*
+ * Second version of a submission: resubmission.diff is its diff against the
+ * first one. With caos-batch --diff, only the lines it adds are checked.
+++ the limit is kept in a variable
+ */
+
+struct bad_counter {  // should not trigger a warning (context line of the hunk)
+    int value;
+};
+
+int count_down(int from) {
+    int steps = 0;
+    while (from > 0) {
+        --from;
+        ++steps;
+    }
+    return steps;
+}
+
+struct bad_limits {  // should trigger a warning (bad case, added line)
+    int max;
+};
+
+int main() {
+    int before = 7;  // should not trigger a warning (context line of the hunk)
+    int limit = 100;  // should trigger a warning (magic number, added line)
+    int after = 9;  // should not trigger a warning (context line of the hunk)
+    return count_down(limit) + before + after;
+}